@@ -0,0 +1,40 @@
+#!/bin/sh
+# Checks that a transfer split over worker processes writes the same weight file and
+# mesh as a single process run with several threads, in both the memory and stream modes.
+#
+# usage: checkProcesses.sh <weightTransferCli> <source mesh> <destination mesh>
+
+if [ $# -ne 3 ]; then
+	echo "usage: $0 <weightTransferCli> <source mesh> <destination mesh>" >&2
+	exit 2
+fi
+cli=$1
+source_mesh=$2
+dest_mesh=$3
+extension=${dest_mesh##*.}
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+for mode in memory stream; do
+	"$cli" --mode "$mode" --threads 4 --weights-out "$work/threads.wtw" \
+		"$source_mesh" "$dest_mesh" "$work/threads.$extension" > "$work/transfer.log" 2>&1 &&
+	"$cli" --mode "$mode" --processes 3 --weights-out "$work/processes.wtw" \
+		"$source_mesh" "$dest_mesh" "$work/processes.$extension" >> "$work/transfer.log" 2>&1
+	if [ $? -ne 0 ]; then
+		echo "$mode mode: the transfer failed" >&2
+		cat "$work/transfer.log" >&2
+		failed=1
+		continue
+	fi
+	for file in wtw "$extension"; do
+		if cmp -s "$work/threads.$file" "$work/processes.$file"; then
+			echo "$mode mode: the .$file files of 3 processes and 4 threads are identical"
+		else
+			echo "$mode mode: the .$file files of 3 processes and 4 threads differ" >&2
+			failed=1
+		fi
+	done
+done
+exit $failed
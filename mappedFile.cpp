@@ -0,0 +1,227 @@
+
+#include <mappedFile.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace WeightTransferTool
+{
+	// MappedFile class constructor.
+	MappedFile::MappedFile()
+	{
+		data = NULL;
+		size = 0;
+		writable = false;
+#ifdef _WIN32
+		file_handle = NULL;
+		mapping_handle = NULL;
+#endif
+	}
+
+	// MappedFile class deconstructor.
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	// Maps a file for reading, returns false on failure.
+	bool MappedFile::open(const char* path)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+								  FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if(file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER file_size;
+		if(!GetFileSizeEx(file, &file_size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+		file_handle = file;
+		size = (size_t)file_size.QuadPart;
+		if(size == 0)
+			return true;
+
+		mapping_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(mapping_handle == NULL)
+		{
+			close();
+			return false;
+		}
+		data = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+		if(data == NULL)
+		{
+			close();
+			return false;
+		}
+#else
+		int file = ::open(path, O_RDONLY);
+		if(file < 0)
+			return false;
+		struct stat file_stat;
+		if(fstat(file, &file_stat) != 0)
+		{
+			::close(file);
+			return false;
+		}
+		size = (size_t)file_stat.st_size;
+		if(size == 0)
+		{
+			::close(file);
+			return true;
+		}
+
+		// the mapping stays valid after the descriptor is closed
+		void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if(mapping == MAP_FAILED)
+		{
+			size = 0;
+			return false;
+		}
+		data = (const char*)mapping;
+		madvise(mapping, size, MADV_SEQUENTIAL);
+#endif
+		return true;
+	}
+
+	// Creates a file of the given size and maps it for writing.
+	bool MappedFile::create(const char* path, size_t new_size)
+	{
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+								  FILE_ATTRIBUTE_NORMAL, NULL);
+		if(file == INVALID_HANDLE_VALUE)
+			return false;
+		file_handle = file;
+		size = new_size;
+		writable = true;
+		if(size == 0)
+			return true;
+
+		LARGE_INTEGER mapping_size;
+		mapping_size.QuadPart = (LONGLONG)size;
+		mapping_handle = CreateFileMappingA(file, NULL, PAGE_READWRITE, mapping_size.HighPart,
+											mapping_size.LowPart, NULL);
+		if(mapping_handle == NULL)
+		{
+			close();
+			return false;
+		}
+		data = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_WRITE, 0, 0, 0);
+		if(data == NULL)
+		{
+			close();
+			return false;
+		}
+#else
+		int file = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(file < 0)
+			return false;
+		if(ftruncate(file, (off_t)new_size) != 0)
+		{
+			::close(file);
+			return false;
+		}
+		size = new_size;
+		writable = true;
+		if(size == 0)
+		{
+			::close(file);
+			return true;
+		}
+
+		void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+		::close(file);
+		if(mapping == MAP_FAILED)
+		{
+			size = 0;
+			writable = false;
+			return false;
+		}
+		data = (const char*)mapping;
+#endif
+		return true;
+	}
+
+	// Unmaps the file.
+	void MappedFile::close()
+	{
+#ifdef _WIN32
+		if(data != NULL)
+		{
+			if(writable)
+				FlushViewOfFile(data, 0);
+			UnmapViewOfFile(data);
+		}
+		if(mapping_handle != NULL)
+			CloseHandle(mapping_handle);
+		if(file_handle != NULL)
+			CloseHandle(file_handle);
+		mapping_handle = NULL;
+		file_handle = NULL;
+#else
+		if(data != NULL)
+		{
+			if(writable)
+				msync((void*)data, size, MS_SYNC);
+			munmap((void*)data, size);
+		}
+#endif
+		data = NULL;
+		size = 0;
+		writable = false;
+	}
+
+	// Tells the system a byte range will not be read again so its pages can
+	// leave the resident set.  Returns the offset a following release starts
+	// at to cover the pages left, the start of the last partly covered page.
+	size_t MappedFile::release(size_t offset, size_t length)
+	{
+		if(data == NULL || offset >= size)
+			return offset;
+		if(offset + length > size)
+			length = size - offset;
+#ifdef _WIN32
+		// Unlocking pages which are not locked removes them from the working set,
+		// including pages the range only covers part of.
+		VirtualUnlock((void*)(data + offset), length);
+		return offset + length;
+#else
+		// only whole pages can be released
+		size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+		size_t start = (offset + page_size - 1) / page_size * page_size;
+		size_t end = (offset + length) / page_size * page_size;
+		if(end > start)
+			madvise((void*)(data + start), end - start, MADV_DONTNEED);
+		return end > offset ? end : offset;
+#endif
+	}
+
+	// Returns the start of the mapped file.
+	const char* MappedFile::get_data() const
+	{
+		return data;
+	}
+
+	// Returns the start of a file mapped for writing or NULL.
+	char* MappedFile::get_writable_data()
+	{
+		return writable ? (char*)data : NULL;
+	}
+
+	// Returns the size of the mapped file in bytes.
+	size_t MappedFile::get_size() const
+	{
+		return size;
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,40 @@
+#ifndef __MAPPED_FILE__
+#define __MAPPED_FILE__
+
+#include <stddef.h>
+
+namespace WeightTransferTool
+{
+	// This class maps a whole file into memory for reading,
+	// or creates a file of a given size and maps it for writing.
+	class MappedFile
+	{
+		public:
+			MappedFile();							// MappedFile class constructor.
+			~MappedFile();							// MappedFile class deconstructor.
+			bool open(const char*);					// Maps a file for reading, returns false on failure.
+			bool create(const char*, size_t);		// Creates a file of the given size and maps it for
+													// writing, returns false on failure.
+			void close();							// Unmaps the file.
+			size_t release(size_t, size_t);			// Tells the system a byte range will not be read again so its
+													// pages can leave the resident set.  Returns the offset a
+													// following release starts at to cover the pages left.
+			const char* get_data() const;			// Returns the start of the mapped file.
+			char* get_writable_data();				// Returns the start of a file mapped for writing or NULL.
+			size_t get_size() const;				// Returns the size of the mapped file in bytes.
+
+		private:
+			MappedFile(const MappedFile&);			// Mapped files cannot be copied.
+			MappedFile& operator=(const MappedFile&);
+
+			const char* data;						// The start of the mapped file.
+			size_t size;							// The size of the mapped file in bytes.
+			bool writable;							// Indicates the file is mapped for writing.
+#ifdef _WIN32
+			void* file_handle;						// The handle of the open file.
+			void* mapping_handle;					// The handle of the file mapping.
+#endif
+	};
+}
+
+#endif // end if undefined __MAPPED_FILE__
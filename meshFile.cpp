@@ -0,0 +1,933 @@
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <meshFile.h>
+
+namespace WeightTransferTool
+{
+	// the largest text token read from a mesh file
+	static const unsigned MAX_TOKEN_SIZE = 64;
+	// the names given to attribute values a file does not name
+	static const char* DEFAULT_ATTRIBUTE_NAMES[WEIGHT_COUNT] = {"w0", "w1", "w2", "w3"};
+
+	// Returns true if this machine stores numbers least significant byte first.
+	static bool host_is_little_endian()
+	{
+		unsigned value = 1;
+		return *(const char*)&value == 1;
+	}
+
+	// Returns true if a file path ends with the given extension, ignoring case.
+	static bool has_extension(const char* path, const char* extension)
+	{
+		size_t path_length = strlen(path);
+		size_t extension_length = strlen(extension);
+		if(path_length < extension_length)
+			return false;
+		const char* suffix = path + path_length - extension_length;
+		for(size_t i = 0; i < extension_length; i++)
+			if(tolower((unsigned char)suffix[i]) != extension[i])
+				return false;
+		return true;
+	}
+
+	// Skips spaces and tabs, but not line ends.
+	static size_t skip_spaces(const char* data, size_t offset, size_t size)
+	{
+		while(offset < size && (data[offset] == ' ' || data[offset] == '\t' || data[offset] == '\r'))
+			offset++;
+		return offset;
+	}
+
+	// Returns the offset of the start of the next line.
+	static size_t next_line(const char* data, size_t offset, size_t size)
+	{
+		while(offset < size && data[offset] != '\n')
+			offset++;
+		return offset < size ? offset + 1 : size;
+	}
+
+	// Copies the next token on the current line into a buffer.
+	// Returns false if the line has no more tokens.
+	static bool read_token(const char* data, size_t& offset, size_t size, char* token)
+	{
+		offset = skip_spaces(data, offset, size);
+		unsigned length = 0;
+		while(offset < size && !isspace((unsigned char)data[offset]))
+		{
+			if(length < MAX_TOKEN_SIZE - 1)
+				token[length++] = data[offset];
+			offset++;
+		}
+		token[length] = '\0';
+		return length > 0;
+	}
+
+	// Parses a whole token as a number.
+	static bool parse_double(const char* token, double& value)
+	{
+		char* end;
+		value = strtod(token, &end);
+		return end != token && *end == '\0';
+	}
+
+	// Returns true if a line starts with a keyword followed by white space.
+	static bool line_starts_with(const char* data, size_t offset, size_t size, const char* keyword)
+	{
+		offset = skip_spaces(data, offset, size);
+		size_t length = strlen(keyword);
+		if(offset + length >= size || strncmp(data + offset, keyword, length) != 0)
+			return false;
+		return isspace((unsigned char)data[offset + length]) != 0;
+	}
+
+	// Returns the PLY type with the given name.
+	static PlyType get_ply_type(const std::string& name)
+	{
+		if(name == "char" || name == "int8")
+			return PLY_INT8;
+		if(name == "uchar" || name == "uint8")
+			return PLY_UINT8;
+		if(name == "short" || name == "int16")
+			return PLY_INT16;
+		if(name == "ushort" || name == "uint16")
+			return PLY_UINT16;
+		if(name == "int" || name == "int32")
+			return PLY_INT32;
+		if(name == "uint" || name == "uint32")
+			return PLY_UINT32;
+		if(name == "float" || name == "float32")
+			return PLY_FLOAT32;
+		if(name == "double" || name == "float64")
+			return PLY_FLOAT64;
+		return PLY_INVALID;
+	}
+
+	// Returns the number of bytes of a binary PLY value.
+	static size_t get_ply_type_size(PlyType type)
+	{
+		switch(type)
+		{
+			case PLY_INT8:
+			case PLY_UINT8:
+				return 1;
+			case PLY_INT16:
+			case PLY_UINT16:
+				return 2;
+			case PLY_INT32:
+			case PLY_UINT32:
+			case PLY_FLOAT32:
+				return 4;
+			case PLY_FLOAT64:
+				return 8;
+			default:
+				return 0;
+		}
+	}
+
+	// Returns the index of the property with the given name or -1.
+	static int find_ply_property(const PlyElement& element, const char* name)
+	{
+		for(unsigned i = 0; i < element.properties.size(); i++)
+			if(element.properties[i].name == name)
+				return (int)i;
+		return -1;
+	}
+
+	// Returns the format of a mesh file from its extension.
+	MeshFormat get_mesh_format(const char* path)
+	{
+		if(has_extension(path, ".obj"))
+			return OBJ_FORMAT;
+		if(has_extension(path, ".ply"))
+			return PLY_FORMAT;
+		if(has_extension(path, ".wtm"))
+			return BINARY_MESH_FORMAT;
+		return UNKNOWN_FORMAT;
+	}
+
+	// Reads every vertex and face of a mesh file into a surface, building its polygons over
+	// the given number of threads.  Polygons are split into triangle fans.  The search structures are left for the caller to build, so several
+	// meshes can be appended into one surface first.
+	bool load_surface(MeshReader& reader, WeightedSurface& surface, unsigned thread_count)
+	{
+		unsigned vertex_count = reader.get_vertex_count();
+		// a mesh without attributes gets its weights from a weight file
+		unsigned channel_count = reader.get_channel_count() > 0 ? reader.get_channel_count() : 1;
+		surface.set_vertex_count(vertex_count, channel_count);
+
+		std::vector<Point3d> positions(DEFAULT_LOAD_CHUNK_SIZE);
+		std::vector<double> weights(DEFAULT_LOAD_CHUNK_SIZE * WEIGHT_COUNT);
+		unsigned index = 0;
+		unsigned count;
+		while((count = reader.read_vertices(&positions[0], &weights[0], DEFAULT_LOAD_CHUNK_SIZE)) > 0)
+		{
+			for(unsigned i = 0; i < count; i++)
+				surface.set_vertex(index++, positions[i], &weights[i * WEIGHT_COUNT]);
+		}
+		if(index != vertex_count)
+			return false;
+
+		std::vector<int> tri_counts;
+		std::vector<int> tri_verts;
+		std::vector<int> face_verts;
+		tri_counts.reserve(reader.get_face_count());
+		while(reader.read_face(face_verts))
+		{
+			int face_size = (int)face_verts.size();
+			for(int i = 0; i < face_size; i++)
+				if(face_verts[i] < 0 || face_verts[i] >= (int)vertex_count)
+					return false;
+			int tri_count = face_size > 2 ? face_size - 2 : 0;
+			for(int i = 0; i < tri_count; i++)
+			{
+				tri_verts.push_back(face_verts[0]);
+				tri_verts.push_back(face_verts[i + 1]);
+				tri_verts.push_back(face_verts[i + 2]);
+			}
+			tri_counts.push_back(tri_count);
+		}
+		if(reader.has_face_error())
+			return false;
+
+		surface.set_polygons((unsigned)tri_counts.size(), tri_counts.data(), tri_verts.data(), thread_count);
+		return true;
+	}
+
+	// MeshReader class constructor.
+	MeshReader::MeshReader()
+	{
+		format = UNKNOWN_FORMAT;
+		release_pages = false;
+		vertex_count = 0;
+		face_count = 0;
+		channel_count = 0;
+		vertex_offset = 0;
+		face_offset = 0;
+		released_offset = 0;
+		vertices_read = 0;
+		faces_read = 0;
+		face_error = false;
+		face_vertices_seen = 0;
+		face_data_end = 0;
+		ply_ascii = false;
+		ply_swap_bytes = false;
+		face_index_property = -1;
+	}
+
+	// Opens a mesh file and reads its header.
+	bool MeshReader::open(const char* path, const std::vector<std::string>& selected_attributes)
+	{
+		format = get_mesh_format(path);
+		if(format == UNKNOWN_FORMAT)
+			return fail(std::string("Unsupported mesh file type: ") + path);
+		if(!file.open(path))
+			return fail(std::string("Unable to open mesh file: ") + path);
+
+		vertices_read = 0;
+		faces_read = 0;
+		face_error = false;
+		face_vertices_seen = 0;
+		released_offset = 0;
+		face_data_end = file.get_size();
+		attribute_names.clear();
+
+		switch(format)
+		{
+			case OBJ_FORMAT:
+				return open_obj();
+			case PLY_FORMAT:
+				return open_ply(selected_attributes);
+			case BINARY_MESH_FORMAT:
+				return open_binary();
+			default:
+				return false;
+		}
+	}
+
+	// Counts the vertices and faces of an OBJ file.
+	bool MeshReader::open_obj()
+	{
+		const char* data = file.get_data();
+		size_t size = file.get_size();
+		char token[MAX_TOKEN_SIZE];
+
+		vertex_count = 0;
+		face_count = 0;
+		channel_count = 0;
+		vertex_offset = size;
+		face_offset = 0;
+
+		unsigned first_value_count = 0;
+		unsigned line_number = 1;
+		for(size_t offset = 0; offset < size; offset = next_line(data, offset, size), line_number++)
+		{
+			if(line_starts_with(data, offset, size, "v"))
+			{
+				size_t cursor = offset;
+				unsigned value_count = 0;
+				read_token(data, cursor, size, token);
+				while(read_token(data, cursor, size, token))
+					value_count++;
+				if(vertex_count == 0)
+				{
+					// Values after the position are the vertex attributes,
+					// the first vertex decides how many there are.
+					if(value_count < 3)
+						return fail("An OBJ vertex has fewer than three coordinates.");
+					vertex_offset = offset;
+					first_value_count = value_count;
+					channel_count = value_count - 3;
+					if(channel_count > WEIGHT_COUNT)
+						channel_count = WEIGHT_COUNT;
+				}
+				else if(value_count != first_value_count)
+				{
+					char message[128];
+					snprintf(message, sizeof(message), "The OBJ vertex on line %u has %u values, the first vertex has %u.",
+							 line_number, value_count, first_value_count);
+					return fail(message);
+				}
+				vertex_count++;
+			}
+			else if(line_starts_with(data, offset, size, "f"))
+				face_count++;
+		}
+
+		for(unsigned i = 0; i < channel_count; i++)
+			attribute_names.push_back(DEFAULT_ATTRIBUTE_NAMES[i]);
+		return true;
+	}
+
+	// Parses the header of a PLY file.
+	bool MeshReader::open_ply(const std::vector<std::string>& selected_attributes)
+	{
+		const char* data = file.get_data();
+		size_t size = file.get_size();
+		char token[MAX_TOKEN_SIZE];
+
+		if(size < 4 || strncmp(data, "ply", 3) != 0)
+			return fail("The file is not a PLY file.");
+
+		std::vector<PlyElement> elements;
+		size_t offset = next_line(data, 0, size);
+		bool header_done = false;
+
+		while(offset < size && !header_done)
+		{
+			size_t cursor = offset;
+			offset = next_line(data, offset, size);
+			if(!read_token(data, cursor, size, token))
+				continue;
+			std::string keyword(token);
+
+			if(keyword == "end_header")
+				header_done = true;
+			else if(keyword == "format")
+			{
+				read_token(data, cursor, size, token);
+				std::string format_name(token);
+				ply_ascii = format_name == "ascii";
+				if(format_name == "binary_little_endian")
+					ply_swap_bytes = !host_is_little_endian();
+				else if(format_name == "binary_big_endian")
+					ply_swap_bytes = host_is_little_endian();
+				else if(!ply_ascii)
+					return fail("Unknown PLY format: " + format_name);
+			}
+			else if(keyword == "element")
+			{
+				PlyElement element;
+				read_token(data, cursor, size, token);
+				element.name = token;
+				read_token(data, cursor, size, token);
+				element.count = (unsigned)strtoul(token, NULL, 10);
+				elements.push_back(element);
+			}
+			else if(keyword == "property")
+			{
+				if(elements.empty())
+					return fail("A PLY property is declared before any element.");
+				PlyProperty property;
+				read_token(data, cursor, size, token);
+				property.count_type = PLY_INVALID;
+				if(std::string(token) == "list")
+				{
+					read_token(data, cursor, size, token);
+					property.count_type = get_ply_type(token);
+					read_token(data, cursor, size, token);
+					if(property.count_type == PLY_INVALID)
+						return fail("Unknown PLY list count type.");
+				}
+				property.type = get_ply_type(token);
+				if(property.type == PLY_INVALID)
+					return fail(std::string("Unknown PLY property type: ") + token);
+				read_token(data, cursor, size, token);
+				property.name = token;
+				elements.back().properties.push_back(property);
+			}
+		}
+		if(!header_done)
+			return fail("The PLY header has no end.");
+
+		// locate the vertex and face data, skipping any other elements
+		bool has_vertices = false;
+		bool has_faces = false;
+		for(unsigned i = 0; i < elements.size(); i++)
+		{
+			if(elements[i].name == "vertex")
+			{
+				ply_vertex = elements[i];
+				vertex_offset = offset;
+				has_vertices = true;
+			}
+			else if(elements[i].name == "face")
+			{
+				ply_face = elements[i];
+				face_offset = offset;
+				has_faces = true;
+			}
+			if(!skip_ply_element(elements[i], offset))
+				return fail("The PLY file is shorter than its header describes.");
+		}
+		if(!has_vertices)
+			return fail("The PLY file has no vertex element.");
+
+		vertex_count = ply_vertex.count;
+		face_count = has_faces ? ply_face.count : 0;
+		ply_vertex_values.assign(ply_vertex.properties.size(), 0.0);
+
+		const char* position_names[3] = {"x", "y", "z"};
+		for(unsigned axis = 0; axis < 3; axis++)
+		{
+			position_properties[axis] = find_ply_property(ply_vertex, position_names[axis]);
+			if(position_properties[axis] < 0)
+				return fail(std::string("The PLY vertex element has no ") + position_names[axis] + " property.");
+		}
+
+		face_index_property = find_ply_property(ply_face, "vertex_indices");
+		if(face_index_property < 0)
+			face_index_property = find_ply_property(ply_face, "vertex_index");
+		if(has_faces && face_index_property < 0)
+			return fail("The PLY face element has no vertex_indices property.");
+
+		// pick the attribute properties
+		channel_count = 0;
+		if(!selected_attributes.empty())
+		{
+			if(selected_attributes.size() > WEIGHT_COUNT)
+				return fail("At most four attribute values per vertex are supported.");
+			for(unsigned i = 0; i < selected_attributes.size(); i++)
+			{
+				int property = find_ply_property(ply_vertex, selected_attributes[i].c_str());
+				if(property < 0 || ply_vertex.properties[property].count_type != PLY_INVALID)
+					return fail("The PLY vertex element has no scalar property " + selected_attributes[i] + ".");
+				channel_properties[channel_count++] = property;
+				attribute_names.push_back(selected_attributes[i]);
+			}
+		}
+		else
+		{
+			for(unsigned i = 0; i < ply_vertex.properties.size() && channel_count < WEIGHT_COUNT; i++)
+			{
+				const PlyProperty& property = ply_vertex.properties[i];
+				if(property.count_type != PLY_INVALID ||
+				   (int)i == position_properties[0] ||
+				   (int)i == position_properties[1] ||
+				   (int)i == position_properties[2])
+					continue;
+				channel_properties[channel_count++] = (int)i;
+				attribute_names.push_back(property.name);
+			}
+		}
+		return true;
+	}
+
+	// Parses the header of a binary mesh file.
+	bool MeshReader::open_binary()
+	{
+		BinaryMeshHeader header;
+		if(file.get_size() < sizeof(header))
+			return fail("The binary mesh file is too small.");
+		memcpy(&header, file.get_data(), sizeof(header));
+		if(memcmp(header.magic, BINARY_MESH_MAGIC, sizeof(header.magic)) != 0)
+			return fail("The file is not a binary mesh file.");
+		if(header.version != BINARY_MESH_VERSION)
+			return fail("Unsupported binary mesh file version.");
+		if(header.channel_count > WEIGHT_COUNT)
+			return fail("At most four attribute values per vertex are supported.");
+
+		vertex_count = header.vertex_count;
+		face_count = header.face_count;
+		channel_count = header.channel_count;
+		vertex_offset = sizeof(header);
+		face_offset = vertex_offset + (size_t)vertex_count * (3 + channel_count) * sizeof(double);
+		face_data_end = face_offset + (size_t)header.face_data_size * sizeof(int);
+		if(face_data_end > file.get_size())
+			return fail("The binary mesh file is shorter than its header describes.");
+
+		for(unsigned i = 0; i < channel_count; i++)
+			attribute_names.push_back(DEFAULT_ATTRIBUTE_NAMES[i]);
+		return true;
+	}
+
+	// Returns the offset after an element's data.
+	bool MeshReader::skip_ply_element(const PlyElement& element, size_t& offset) const
+	{
+		const char* data = file.get_data();
+		size_t size = file.get_size();
+
+		if(ply_ascii)
+		{
+			for(unsigned i = 0; i < element.count && offset < size; i++)
+				offset = next_line(data, offset, size);
+			return offset <= size;
+		}
+
+		// Elements without lists have a fixed size.
+		size_t item_size = 0;
+		bool has_list = false;
+		for(unsigned j = 0; j < element.properties.size(); j++)
+		{
+			if(element.properties[j].count_type != PLY_INVALID)
+				has_list = true;
+			item_size += get_ply_type_size(element.properties[j].type);
+		}
+		if(!has_list)
+		{
+			offset += item_size * element.count;
+			return offset <= size;
+		}
+
+		for(unsigned i = 0; i < element.count; i++)
+			for(unsigned j = 0; j < element.properties.size(); j++)
+			{
+				const PlyProperty& property = element.properties[j];
+				if(property.count_type == PLY_INVALID)
+				{
+					offset += get_ply_type_size(property.type);
+					continue;
+				}
+				double list_count;
+				if(!read_ply_value(property.count_type, offset, list_count))
+					return false;
+				offset += get_ply_type_size(property.type) * (size_t)list_count;
+			}
+		return offset <= size;
+	}
+
+	// Reads one PLY value at an offset.
+	bool MeshReader::read_ply_value(PlyType type, size_t& offset, double& value) const
+	{
+		const char* data = file.get_data();
+		size_t size = file.get_size();
+
+		if(ply_ascii)
+		{
+			char token[MAX_TOKEN_SIZE];
+			return read_token(data, offset, size, token) && parse_double(token, value);
+		}
+
+		size_t type_size = get_ply_type_size(type);
+		if(offset + type_size > size)
+			return false;
+		unsigned char bytes[8];
+		for(size_t i = 0; i < type_size; i++)
+			bytes[i] = data[offset + (ply_swap_bytes ? type_size - 1 - i : i)];
+		offset += type_size;
+
+		switch(type)
+		{
+			case PLY_INT8:		{ signed char v; memcpy(&v, bytes, 1); value = v; break; }
+			case PLY_UINT8:		{ unsigned char v; memcpy(&v, bytes, 1); value = v; break; }
+			case PLY_INT16:		{ short v; memcpy(&v, bytes, 2); value = v; break; }
+			case PLY_UINT16:	{ unsigned short v; memcpy(&v, bytes, 2); value = v; break; }
+			case PLY_INT32:		{ int v; memcpy(&v, bytes, 4); value = v; break; }
+			case PLY_UINT32:	{ unsigned v; memcpy(&v, bytes, 4); value = v; break; }
+			case PLY_FLOAT32:	{ float v; memcpy(&v, bytes, 4); value = v; break; }
+			case PLY_FLOAT64:	{ memcpy(&value, bytes, 8); break; }
+			default:
+				return false;
+		}
+		return true;
+	}
+
+	// Reads up to the given number of vertices and returns the number read.
+	unsigned MeshReader::read_vertices(Point3d* positions, double* weights, unsigned max_count)
+	{
+		const char* data = file.get_data();
+		size_t size = file.get_size();
+		char token[MAX_TOKEN_SIZE];
+		double values[3 + WEIGHT_COUNT];
+		unsigned count = 0;
+
+		while(count < max_count && vertices_read < vertex_count)
+		{
+			switch(format)
+			{
+				case OBJ_FORMAT:
+				{
+					// skip to the next vertex line
+					while(vertex_offset < size && !line_starts_with(data, vertex_offset, size, "v"))
+						vertex_offset = next_line(data, vertex_offset, size);
+					size_t cursor = vertex_offset;
+					read_token(data, cursor, size, token);
+					for(unsigned i = 0; i < 3 + channel_count; i++)
+						if(!read_token(data, cursor, size, token) || !parse_double(token, values[i]))
+							values[i] = 0.0;
+					vertex_offset = next_line(data, vertex_offset, size);
+					break;
+				}
+				case PLY_FORMAT:
+				{
+					for(unsigned j = 0; j < ply_vertex.properties.size(); j++)
+					{
+						const PlyProperty& property = ply_vertex.properties[j];
+						double value = 0.0;
+						if(property.count_type != PLY_INVALID)
+						{
+							// skip list properties of the vertex
+							double list_count = 0.0;
+							read_ply_value(property.count_type, vertex_offset, list_count);
+							for(unsigned k = 0; k < list_count; k++)
+								if(!read_ply_value(property.type, vertex_offset, value))
+									break;
+						}
+						else
+							read_ply_value(property.type, vertex_offset, value);
+						ply_vertex_values[j] = value;
+					}
+					if(ply_ascii)
+						vertex_offset = next_line(data, vertex_offset, size);
+					for(unsigned axis = 0; axis < 3; axis++)
+						values[axis] = ply_vertex_values[position_properties[axis]];
+					for(unsigned i = 0; i < channel_count; i++)
+						values[3 + i] = ply_vertex_values[channel_properties[i]];
+					break;
+				}
+				case BINARY_MESH_FORMAT:
+				{
+					size_t record_size = (3 + channel_count) * sizeof(double);
+					memcpy(values, data + vertex_offset, record_size);
+					vertex_offset += record_size;
+					break;
+				}
+				default:
+					return count;
+			}
+
+			positions[count].x = values[0];
+			positions[count].y = values[1];
+			positions[count].z = values[2];
+			if(weights != NULL)
+				expand_channels(&values[3], channel_count, &weights[count * WEIGHT_COUNT]);
+			count++;
+			vertices_read++;
+		}
+
+		if(release_pages && vertex_offset > released_offset)
+		{
+			file.release(released_offset, vertex_offset - released_offset);
+			released_offset = vertex_offset;
+		}
+		return count;
+	}
+
+	// Skips the given number of vertices, returns the number skipped.
+	unsigned MeshReader::skip_vertices(unsigned count)
+	{
+		// text vertices have no fixed size so they are read and dropped
+		std::vector<Point3d> positions(std::min(count, DEFAULT_LOAD_CHUNK_SIZE));
+		unsigned skipped = 0;
+		while(skipped < count)
+		{
+			unsigned read = read_vertices(&positions[0], NULL, std::min(count - skipped, DEFAULT_LOAD_CHUNK_SIZE));
+			if(read == 0)
+				break;
+			skipped += read;
+		}
+		return skipped;
+	}
+
+	// Reads the vertex indices of the next face.
+	bool MeshReader::read_face(std::vector<int>& face_verts)
+	{
+		const char* data = file.get_data();
+		size_t size = file.get_size();
+		char token[MAX_TOKEN_SIZE];
+		face_verts.clear();
+		if(faces_read >= face_count)
+			return false;
+
+		switch(format)
+		{
+			case OBJ_FORMAT:
+			{
+				// Relative indices count back from the vertices defined
+				// so far, so vertex lines are counted on the way.
+				while(face_offset < size && !line_starts_with(data, face_offset, size, "f"))
+				{
+					if(line_starts_with(data, face_offset, size, "v"))
+						face_vertices_seen++;
+					face_offset = next_line(data, face_offset, size);
+				}
+				size_t cursor = face_offset;
+				read_token(data, cursor, size, token);
+				while(read_token(data, cursor, size, token))
+				{
+					// only the position index before any '/' is used
+					int index = atoi(token);
+					if(index < 0)
+						index += (int)face_vertices_seen;
+					else
+						index -= 1;
+					face_verts.push_back(index);
+				}
+				face_offset = next_line(data, face_offset, size);
+				break;
+			}
+			case PLY_FORMAT:
+			{
+				for(unsigned j = 0; j < ply_face.properties.size(); j++)
+				{
+					const PlyProperty& property = ply_face.properties[j];
+					double value = 0.0;
+					if(property.count_type == PLY_INVALID)
+					{
+						if(!read_ply_value(property.type, face_offset, value))
+							return fail_face("The PLY face data is shorter than its header describes.");
+						continue;
+					}
+					double list_count = 0.0;
+					if(!read_ply_value(property.count_type, face_offset, list_count) || list_count < 0.0 ||
+					   list_count > (double)(size - face_offset))
+						return fail_face("The PLY face data is shorter than its header describes.");
+					for(unsigned k = 0; k < (unsigned)list_count; k++)
+					{
+						if(!read_ply_value(property.type, face_offset, value))
+							return fail_face("The PLY face data is shorter than its header describes.");
+						if((int)j == face_index_property)
+							face_verts.push_back((int)value);
+					}
+				}
+				if(ply_ascii)
+					face_offset = next_line(data, face_offset, size);
+				break;
+			}
+			case BINARY_MESH_FORMAT:
+			{
+				// the face size comes from the file, so the face must fit in the face data
+				int face_size;
+				if(face_offset + sizeof(int) > face_data_end)
+					return fail_face("The binary mesh file has fewer faces than its header describes.");
+				memcpy(&face_size, data + face_offset, sizeof(int));
+				face_offset += sizeof(int);
+				if(face_size < 0 || (size_t)face_size > (face_data_end - face_offset) / sizeof(int))
+					return fail_face("A binary mesh face is larger than the face data.");
+				face_verts.resize(face_size);
+				if(face_size > 0)
+					memcpy(&face_verts[0], data + face_offset, face_size * sizeof(int));
+				face_offset += face_size * sizeof(int);
+				break;
+			}
+			default:
+				return false;
+		}
+
+		faces_read++;
+		return true;
+	}
+
+	// Returns true if reading a face failed on damaged data.
+	bool MeshReader::has_face_error() const
+	{
+		return face_error;
+	}
+
+	// Releases the pages of vertices once they are read.
+	void MeshReader::set_release_pages(bool new_release_pages)
+	{
+		release_pages = new_release_pages;
+	}
+
+	// Returns the number of vertices in the file.
+	unsigned MeshReader::get_vertex_count() const
+	{
+		return vertex_count;
+	}
+
+	// Returns the number of faces in the file.
+	unsigned MeshReader::get_face_count() const
+	{
+		return face_count;
+	}
+
+	// Returns the number of attribute values per vertex.
+	unsigned MeshReader::get_channel_count() const
+	{
+		return channel_count;
+	}
+
+	// Returns the attribute names.
+	const std::vector<std::string>& MeshReader::get_attribute_names() const
+	{
+		return attribute_names;
+	}
+
+	// Returns the description of the last error.
+	const std::string& MeshReader::get_error() const
+	{
+		return error;
+	}
+
+	// Stores an error message and returns false.
+	bool MeshReader::fail(const std::string& message)
+	{
+		error = message;
+		return false;
+	}
+
+	// Stores an error message for damaged face data, stops reading faces and returns false.
+	bool MeshReader::fail_face(const std::string& message)
+	{
+		face_error = true;
+		faces_read = face_count;
+		return fail(message);
+	}
+
+	// MeshWriter class constructor.
+	MeshWriter::MeshWriter()
+	{
+		file = NULL;
+		format = UNKNOWN_FORMAT;
+		channel_count = 0;
+		memset(&binary_header, 0, sizeof(binary_header));
+	}
+
+	// MeshWriter class deconstructor.
+	MeshWriter::~MeshWriter()
+	{
+		if(file != NULL)
+			fclose(file);
+	}
+
+	// Creates a mesh file for the given number of vertices, faces and attribute values per vertex.
+	bool MeshWriter::open(const char* path, unsigned vertex_count, unsigned face_count,
+						  unsigned new_channel_count, const std::vector<std::string>& attribute_names)
+	{
+		format = get_mesh_format(path);
+		if(format == UNKNOWN_FORMAT)
+		{
+			error = std::string("Unsupported mesh file type: ") + path;
+			return false;
+		}
+		file = fopen(path, "wb");
+		if(file == NULL)
+		{
+			error = std::string("Unable to create mesh file: ") + path;
+			return false;
+		}
+		channel_count = new_channel_count;
+
+		switch(format)
+		{
+			case OBJ_FORMAT:
+				fprintf(file, "# %u vertices with %u attribute values, %u faces\n",
+						vertex_count, channel_count, face_count);
+				break;
+			case PLY_FORMAT:
+				fprintf(file, "ply\nformat %s 1.0\n", host_is_little_endian() ?
+						"binary_little_endian" : "binary_big_endian");
+				fprintf(file, "element vertex %u\n", vertex_count);
+				fprintf(file, "property double x\nproperty double y\nproperty double z\n");
+				for(unsigned i = 0; i < channel_count; i++)
+					fprintf(file, "property double %s\n", i < attribute_names.size() ?
+							attribute_names[i].c_str() : DEFAULT_ATTRIBUTE_NAMES[i]);
+				fprintf(file, "element face %u\n", face_count);
+				fprintf(file, "property list int int vertex_indices\nend_header\n");
+				break;
+			case BINARY_MESH_FORMAT:
+				// the face data size is filled in on close
+				memcpy(binary_header.magic, BINARY_MESH_MAGIC, sizeof(binary_header.magic));
+				binary_header.version = BINARY_MESH_VERSION;
+				binary_header.vertex_count = vertex_count;
+				binary_header.channel_count = channel_count;
+				binary_header.face_count = face_count;
+				binary_header.face_data_size = 0;
+				fwrite(&binary_header, sizeof(binary_header), 1, file);
+				break;
+			default:
+				break;
+		}
+		return true;
+	}
+
+	// Writes vertex positions and their first channel_count weights out of every WEIGHT_COUNT values.
+	void MeshWriter::write_vertices(const Point3d* positions, const double* weights, unsigned count)
+	{
+		double record[3 + WEIGHT_COUNT];
+		for(unsigned i = 0; i < count; i++)
+		{
+			record[0] = positions[i].x;
+			record[1] = positions[i].y;
+			record[2] = positions[i].z;
+			for(unsigned j = 0; j < channel_count; j++)
+				record[3 + j] = weights[i * WEIGHT_COUNT + j];
+
+			if(format == OBJ_FORMAT)
+			{
+				fprintf(file, "v");
+				for(unsigned j = 0; j < 3 + channel_count; j++)
+					fprintf(file, " %.17g", record[j]);
+				fprintf(file, "\n");
+			}
+			else
+				fwrite(record, sizeof(double), 3 + channel_count, file);
+		}
+	}
+
+	// Writes the vertex indices of the next face.
+	void MeshWriter::write_face(const std::vector<int>& face_verts)
+	{
+		int face_size = (int)face_verts.size();
+		if(format == OBJ_FORMAT)
+		{
+			fprintf(file, "f");
+			for(int i = 0; i < face_size; i++)
+				fprintf(file, " %d", face_verts[i] + 1);
+			fprintf(file, "\n");
+			return;
+		}
+		fwrite(&face_size, sizeof(int), 1, file);
+		if(face_size > 0)
+			fwrite(&face_verts[0], sizeof(int), face_size, file);
+		binary_header.face_data_size += 1 + face_size;
+	}
+
+	// Finishes the file, returns false if any write failed.
+	bool MeshWriter::close()
+	{
+		if(file == NULL)
+			return false;
+		if(format == BINARY_MESH_FORMAT)
+		{
+			fseek(file, 0, SEEK_SET);
+			fwrite(&binary_header, sizeof(binary_header), 1, file);
+		}
+		bool write_failed = ferror(file) != 0;
+		if(fclose(file) != 0)
+			write_failed = true;
+		file = NULL;
+		if(write_failed)
+			error = "Writing the mesh file failed.";
+		return !write_failed;
+	}
+
+	// Returns the description of the last error.
+	const std::string& MeshWriter::get_error() const
+	{
+		return error;
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,168 @@
+#ifndef __MESH_FILE__
+#define __MESH_FILE__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <weightedSurface.h>
+#include <mappedFile.h>
+
+namespace WeightTransferTool
+{
+	// the identifier at the start of a binary mesh file
+	const char BINARY_MESH_MAGIC[4] = {'W', 'T', 'M', 'B'};
+	// the current binary mesh file version
+	const unsigned BINARY_MESH_VERSION = 1;
+	// the number of vertices read at a time while loading a surface
+	const unsigned DEFAULT_LOAD_CHUNK_SIZE = 4096;
+
+	// enumeration of the supported mesh file formats
+	enum MeshFormat
+	{
+		UNKNOWN_FORMAT = 0,
+		OBJ_FORMAT = 1,
+		PLY_FORMAT = 2,
+		BINARY_MESH_FORMAT = 3,
+	};
+
+	// The header of a binary mesh file.  It is followed by one record of
+	// three position doubles and channel_count attribute doubles for every
+	// vertex, then by every face as its vertex count and vertex indices.
+	struct BinaryMeshHeader
+	{
+		char magic[4];							// The BINARY_MESH_MAGIC identifier.
+		unsigned version;						// The file format version.
+		unsigned vertex_count;					// The number of vertex records.
+		unsigned channel_count;					// The number of attribute values per vertex.
+		unsigned face_count;					// The number of faces.
+		unsigned face_data_size;				// The number of integers in the face section.
+	};
+
+	// the numeric types a PLY property can have
+	enum PlyType
+	{
+		PLY_INVALID = 0,
+		PLY_INT8,
+		PLY_UINT8,
+		PLY_INT16,
+		PLY_UINT16,
+		PLY_INT32,
+		PLY_UINT32,
+		PLY_FLOAT32,
+		PLY_FLOAT64,
+	};
+
+	// A scalar or list property of a PLY element.
+	struct PlyProperty
+	{
+		std::string name;						// The property name.
+		PlyType type;							// The scalar or list item type.
+		PlyType count_type;						// The list count type, PLY_INVALID for scalars.
+	};
+
+	// An element declared in a PLY header.
+	struct PlyElement
+	{
+		std::string name;						// The element name.
+		unsigned count;							// The number of items of this element.
+		std::vector<PlyProperty> properties;	// The properties of every item.
+	};
+
+	MeshFormat get_mesh_format(const char*);	// Returns the format of a mesh file from its extension.
+
+	// This class reads the vertex positions, vertex attributes and faces
+	// of a memory-mapped mesh file sequentially.
+	class MeshReader
+	{
+		public:
+			MeshReader();							// MeshReader class constructor.
+			~MeshReader(){};						// MeshReader class deconstructor.
+			bool open(const char*,					// Opens a mesh file and reads its header.  The attribute
+					  const std::vector<std::string>&);	// names select PLY vertex properties, all non-position
+													// properties are used when the list is empty.
+			unsigned read_vertices(Point3d*,		// Reads up to the given number of vertices and returns the
+								   double*,			// number read.  Weights are expanded to WEIGHT_COUNT values
+								   unsigned);		// per vertex and are skipped when the array is NULL.
+			unsigned skip_vertices(unsigned);		// Skips the given number of vertices, returns the number skipped.
+			bool read_face(std::vector<int>&);		// Reads the vertex indices of the next face.  Returns false
+													// after the last face or on damaged face data.
+			bool has_face_error() const;			// Returns true if reading a face failed on damaged data.
+			void set_release_pages(bool);			// Releases the pages of vertices once they are read.
+
+			unsigned get_vertex_count() const;		// Returns the number of vertices in the file.
+			unsigned get_face_count() const;		// Returns the number of faces in the file.
+			unsigned get_channel_count() const;		// Returns the number of attribute values per vertex.
+			const std::vector<std::string>& get_attribute_names() const;	// Returns the attribute names.
+			const std::string& get_error() const;	// Returns the description of the last error.
+
+		private:
+			bool open_obj();						// Counts the vertices and faces of an OBJ file.
+			bool open_ply(const std::vector<std::string>&);	// Parses the header of a PLY file.
+			bool open_binary();						// Parses the header of a binary mesh file.
+			bool skip_ply_element(const PlyElement&, size_t&) const;	// Returns the offset after an element's data.
+			bool read_ply_value(PlyType, size_t&, double&) const;	// Reads one PLY value at an offset.
+			bool fail(const std::string&);			// Stores an error message and returns false.
+			bool fail_face(const std::string&);		// Stores an error message, stops reading faces and returns false.
+
+			MappedFile file;						// The memory-mapped mesh file.
+			MeshFormat format;						// The format of the mesh file.
+			std::string error;						// The description of the last error.
+			bool release_pages;						// Indicates read vertex pages are released.
+
+			unsigned vertex_count;					// The number of vertices in the file.
+			unsigned face_count;					// The number of faces in the file.
+			unsigned channel_count;					// The number of attribute values per vertex.
+			std::vector<std::string> attribute_names;	// The names of the attribute values.
+
+			size_t vertex_offset;					// The file offset of the next vertex.
+			size_t face_offset;						// The file offset of the next face.
+			size_t face_data_end;					// The file offset after the last face.
+			size_t released_offset;					// The file offset up to which pages were released.
+			unsigned vertices_read;					// The number of vertices read so far.
+			unsigned faces_read;					// The number of faces read so far.
+			bool face_error;						// Indicates a face could not be read.
+			unsigned face_vertices_seen;			// The number of OBJ vertices before the next face.
+
+			bool ply_ascii;							// Indicates the PLY data is text.
+			bool ply_swap_bytes;					// Indicates the PLY data byte order differs from this machine.
+			PlyElement ply_vertex;					// The PLY vertex element.
+			PlyElement ply_face;					// The PLY face element.
+			int position_properties[3];				// The vertex properties of the x, y and z coordinates.
+			int channel_properties[WEIGHT_COUNT];	// The vertex properties of each attribute value.
+			std::vector<double> ply_vertex_values;	// The property values of the PLY vertex being read.
+			int face_index_property;				// The face property holding the vertex indices.
+	};
+
+	bool load_surface(MeshReader&,				// Reads every vertex and face of a mesh file into a surface,
+					  WeightedSurface&,			// building its polygons over the given number of threads.
+					  unsigned);				// Polygons are split into triangle fans, the search
+												// structures are left for the caller to build.
+
+	// This class writes a mesh with per-vertex attributes sequentially.
+	// Vertices are written first, then the faces.
+	class MeshWriter
+	{
+		public:
+			MeshWriter();							// MeshWriter class constructor.
+			~MeshWriter();							// MeshWriter class deconstructor.
+			bool open(const char*, unsigned,		// Creates a mesh file for the given number of vertices,
+					  unsigned, unsigned,			// faces and attribute values per vertex.
+					  const std::vector<std::string>&);
+			void write_vertices(const Point3d*,		// Writes vertex positions and their first channel_count
+								const double*,		// weights out of every WEIGHT_COUNT values.
+								unsigned);
+			void write_face(const std::vector<int>&);	// Writes the vertex indices of the next face.
+			bool close();							// Finishes the file, returns false if any write failed.
+			const std::string& get_error() const;	// Returns the description of the last error.
+
+		private:
+			FILE* file;								// The output file.
+			MeshFormat format;						// The format of the output file.
+			std::string error;						// The description of the last error.
+			unsigned channel_count;					// The number of attribute values per vertex.
+			BinaryMeshHeader binary_header;			// The binary mesh header, completed on close.
+	};
+}
+
+#endif // end if undefined __MESH_FILE__
@@ -0,0 +1,230 @@
+
+#include <algorithm>
+#include <vector>
+
+#include <sourceFile.h>
+#include <systemInfo.h>
+
+namespace WeightTransferTool
+{
+	static_assert(sizeof(SourceFileHeader) == SOURCE_FILE_ALIGNMENT, "SourceFileHeader must stay 64 bytes");
+
+	// Rounds a file offset up to the array alignment.
+	static inline size_t align_offset(size_t offset)
+	{
+		return (offset + SOURCE_FILE_ALIGNMENT - 1) / SOURCE_FILE_ALIGNMENT * SOURCE_FILE_ALIGNMENT;
+	}
+
+	// Computes the offset and size of every array in a built source file and returns the file size.
+	size_t get_source_layout(const SourceFileHeader& header, size_t* offsets, size_t* sizes)
+	{
+		sizes[0] = (size_t)header.vertex_count * sizeof(Point3d);
+		sizes[1] = (size_t)header.vertex_count * header.channel_count * header.weight_size;
+		// quantized weights are preceded by the scale and offset of every channel
+		if(header.weight_size == sizeof(unsigned short))
+			sizes[1] += WEIGHT_COUNT * 2 * sizeof(double);
+		sizes[2] = (size_t)header.triangle_count * header.triangle_size;
+		// the polygons are followed by an end marker
+		sizes[3] = ((size_t)header.polygon_count + 1) * sizeof(WeightedPolygon);
+		sizes[4] = (size_t)header.poly_vert_count * sizeof(unsigned);
+		sizes[5] = (size_t)header.node_count * header.node_size;
+		sizes[6] = (size_t)header.triangle_count * sizeof(unsigned);
+
+		size_t offset = sizeof(SourceFileHeader);
+		for(unsigned i = 0; i < SOURCE_SECTION_COUNT; i++)
+		{
+			offsets[i] = align_offset(offset);
+			offset = offsets[i] + sizes[i];
+		}
+		return offset;
+	}
+
+	// Checks every index of a mapped surface against the array it refers to, so a damaged
+	// file cannot make sampling read outside the mapping.  Returns the description of the
+	// first invalid section, or NULL if the surface is valid.
+	static const char* find_invalid_section(const SurfaceBuffers& buffers)
+	{
+		for(unsigned i = 0; i < buffers.triangle_count; i++)
+		{
+			const WeightedTriangle& tri = buffers.tris[i];
+			if(tri.v0 >= buffers.vertex_count || tri.v1 >= buffers.vertex_count || tri.v2 >= buffers.vertex_count)
+				return "a triangle refers to a vertex beyond the positions";
+		}
+
+		// the polygon ranges must cover the triangles and polygon vertices in order
+		const WeightedPolygon* polys = buffers.polys;
+		if(polys[0].first_triangle != 0 || polys[0].first_vertex != 0 ||
+		   polys[buffers.polygon_count].first_triangle != buffers.triangle_count ||
+		   polys[buffers.polygon_count].first_vertex != buffers.poly_vert_count)
+			return "the polygons do not cover the triangles";
+		for(unsigned i = 0; i < buffers.polygon_count; i++)
+			if(polys[i + 1].first_triangle < polys[i].first_triangle ||
+			   polys[i + 1].first_vertex < polys[i].first_vertex)
+				return "the polygon offsets are out of order";
+		for(unsigned i = 0; i < buffers.poly_vert_count; i++)
+			if(buffers.poly_verts[i] != NO_VERTEX && buffers.poly_verts[i] >= buffers.vertex_count)
+				return "a polygon refers to a vertex beyond the positions";
+
+		// Children always follow their parent, so the nodes are checked in
+		// order and the depth of every node is known before its children.
+		if((buffers.node_count == 0) != (buffers.triangle_count == 0))
+			return "the search tree does not cover the triangles";
+		std::vector<unsigned char> depths(buffers.node_count, 0);
+		for(unsigned i = 0; i < buffers.node_count; i++)
+		{
+			const TreeNode& node = buffers.nodes[i];
+			if(node.count > 0)
+			{
+				if((size_t)node.first + node.count > buffers.triangle_count)
+					return "a search tree leaf refers to a triangle beyond the triangles";
+				continue;
+			}
+			if(node.first <= i || (size_t)node.first + 1 >= buffers.node_count)
+				return "a search tree node refers to an invalid child";
+			if(depths[i] + 1u >= MAX_TREE_DEPTH)
+				return "the search tree is too deep";
+			for(unsigned child = node.first; child <= node.first + 1; child++)
+				depths[child] = std::max(depths[child], (unsigned char)(depths[i] + 1));
+		}
+		for(unsigned i = 0; i < buffers.triangle_count; i++)
+			if(buffers.tri_order[i] >= buffers.triangle_count)
+				return "the search tree refers to a triangle beyond the triangles";
+		return NULL;
+	}
+
+	// Stores an error message and returns false.
+	bool SourceFile::fail(const std::string& message)
+	{
+		error = message;
+		file.close();
+		return false;
+	}
+
+	// Writes a built surface to a file, returns false on failure.  The faces
+	// not sampled yet are built first, so a mapped file never builds faces.
+	bool SourceFile::save(const char* path, const WeightedSurface& source)
+	{
+		source.build_faces(get_processor_count());
+		SurfaceBuffers buffers;
+		source.get_buffers(buffers);
+
+		SourceFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, SOURCE_FILE_MAGIC, sizeof(header.magic));
+		header.version = SOURCE_FILE_VERSION;
+		header.vertex_count = buffers.vertex_count;
+		header.channel_count = buffers.channel_count;
+		header.polygon_count = buffers.polygon_count;
+		header.triangle_count = buffers.triangle_count;
+		header.poly_vert_count = buffers.poly_vert_count;
+		header.node_count = buffers.node_count;
+		header.triangle_size = sizeof(WeightedTriangle);
+		header.node_size = sizeof(TreeNode);
+		header.weight_size = buffers.quantized_weights != NULL ? sizeof(unsigned short) : sizeof(double);
+
+		size_t offsets[SOURCE_SECTION_COUNT];
+		size_t sizes[SOURCE_SECTION_COUNT];
+		size_t file_size = get_source_layout(header, offsets, sizes);
+		MappedFile out_file;
+		if(!out_file.create(path, file_size))
+			return fail(std::string("Unable to create source file: ") + path);
+
+		const void* arrays[SOURCE_SECTION_COUNT] =
+		{
+			buffers.positions, buffers.weights, buffers.tris, buffers.polys,
+			buffers.poly_verts, buffers.nodes, buffers.tri_order
+		};
+		// the padding between arrays is already zero in a new file
+		char* data = out_file.get_writable_data();
+		memcpy(data, &header, sizeof(header));
+		if(buffers.quantized_weights != NULL)
+		{
+			double* ranges = (double*)(data + offsets[1]);
+			memcpy(ranges, buffers.weight_scale, sizeof(double) * header.channel_count);
+			memcpy(ranges + WEIGHT_COUNT, buffers.weight_offset, sizeof(double) * header.channel_count);
+			arrays[1] = buffers.quantized_weights;
+			offsets[1] += WEIGHT_COUNT * 2 * sizeof(double);
+			sizes[1] -= WEIGHT_COUNT * 2 * sizeof(double);
+		}
+		for(unsigned i = 0; i < SOURCE_SECTION_COUNT; i++)
+			if(arrays[i] != NULL && sizes[i] > 0)
+				memcpy(data + offsets[i], arrays[i], sizes[i]);
+		out_file.close();
+		return true;
+	}
+
+	// Maps a built source file, returns false on failure.  The indexes of every
+	// section are checked so sampling never reads outside the mapped arrays.
+	bool SourceFile::open(const char* path)
+	{
+		if(!file.open(path))
+			return fail(std::string("Unable to open source file: ") + path);
+
+		SourceFileHeader header;
+		if(file.get_size() < sizeof(header))
+			return fail(std::string("The source file is too small: ") + path);
+		memcpy(&header, file.get_data(), sizeof(header));
+		if(memcmp(header.magic, SOURCE_FILE_MAGIC, sizeof(header.magic)) != 0)
+			return fail(std::string("The file is not a built source file: ") + path);
+		if(header.version == 0 || header.version > SOURCE_FILE_VERSION)
+			return fail(std::string("Unsupported source file version: ") + path);
+		if(header.version == 1)
+			header.weight_size = sizeof(double);
+		if(header.triangle_size != sizeof(WeightedTriangle) || header.node_size != sizeof(TreeNode) ||
+		   header.channel_count == 0 || header.channel_count > WEIGHT_COUNT ||
+		   (header.weight_size != sizeof(double) && header.weight_size != sizeof(unsigned short)))
+			return fail(std::string("The source file was written with a different memory layout: ") + path);
+
+		size_t offsets[SOURCE_SECTION_COUNT];
+		size_t sizes[SOURCE_SECTION_COUNT];
+		if(file.get_size() != get_source_layout(header, offsets, sizes))
+			return fail(std::string("The source file size does not match its header: ") + path);
+
+		const char* data = file.get_data();
+		SurfaceBuffers buffers;
+		buffers.vertex_count = header.vertex_count;
+		buffers.channel_count = header.channel_count;
+		buffers.polygon_count = header.polygon_count;
+		buffers.triangle_count = header.triangle_count;
+		buffers.poly_vert_count = header.poly_vert_count;
+		buffers.node_count = header.node_count;
+		buffers.positions = (const Point3d*)(data + offsets[0]);
+		if(header.weight_size == sizeof(unsigned short))
+		{
+			const double* ranges = (const double*)(data + offsets[1]);
+			buffers.weights = NULL;
+			buffers.weight_scale = ranges;
+			buffers.weight_offset = ranges + WEIGHT_COUNT;
+			buffers.quantized_weights = (const unsigned short*)(ranges + WEIGHT_COUNT * 2);
+		}
+		else
+		{
+			buffers.weights = (const double*)(data + offsets[1]);
+			buffers.weight_scale = NULL;
+			buffers.weight_offset = NULL;
+			buffers.quantized_weights = NULL;
+		}
+		buffers.tris = (const WeightedTriangle*)(data + offsets[2]);
+		buffers.polys = (const WeightedPolygon*)(data + offsets[3]);
+		buffers.poly_verts = (const unsigned*)(data + offsets[4]);
+		buffers.nodes = (const TreeNode*)(data + offsets[5]);
+		buffers.tri_order = (const unsigned*)(data + offsets[6]);
+		const char* invalid_section = find_invalid_section(buffers);
+		if(invalid_section != NULL)
+			return fail(std::string("The source file is damaged, ") + invalid_section + ": " + path);
+		surface.set_buffers(buffers);
+		return true;
+	}
+
+	// Returns the surface sampling the mapped file.
+	const WeightedSurface& SourceFile::get_surface() const
+	{
+		return surface;
+	}
+
+	// Returns the description of the last error.
+	const std::string& SourceFile::get_error() const
+	{
+		return error;
+	}
+} // end namespace WeightTransferTool
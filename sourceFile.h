@@ -0,0 +1,70 @@
+#ifndef __SOURCE_FILE__
+#define __SOURCE_FILE__
+
+#include <string>
+
+#include <weightedSurface.h>
+#include <mappedFile.h>
+
+namespace WeightTransferTool
+{
+	// the identifier at the start of a built source file
+	const char SOURCE_FILE_MAGIC[4] = {'W', 'T', 'S', 'F'};
+	// the current built source file version, version 1 files only hold double weights
+	const unsigned SOURCE_FILE_VERSION = 2;
+	// the alignment of every array in a built source file
+	const unsigned SOURCE_FILE_ALIGNMENT = 64;
+	// the number of arrays in a built source file
+	const unsigned SOURCE_SECTION_COUNT = 7;
+
+	// The header of a built source file.  It is followed by the positions,
+	// weights, triangles, polygons, polygon vertices, tree nodes and tree
+	// triangle order of a built surface, each starting on an
+	// SOURCE_FILE_ALIGNMENT boundary in that order.  Quantized weights start
+	// with the WEIGHT_COUNT decoding scales and offsets of the channels.
+	// The arrays are stored in the memory layout of the machine which wrote
+	// them, the record sizes let a reader reject a file written with another layout.
+	struct SourceFileHeader
+	{
+		char magic[4];							// The SOURCE_FILE_MAGIC identifier.
+		unsigned version;						// The file format version.
+		unsigned vertex_count;					// The number of vertex positions.
+		unsigned channel_count;					// The number of weight channels per vertex.
+		unsigned polygon_count;					// The number of polygons, excluding the end marker.
+		unsigned triangle_count;				// The number of triangles.
+		unsigned poly_vert_count;				// The number of polygon vertex list entries.
+		unsigned node_count;					// The number of search tree nodes.
+		unsigned triangle_size;					// The size of a triangle record in bytes.
+		unsigned node_size;						// The size of a tree node record in bytes.
+		unsigned weight_size;					// The size of a weight value in bytes, 2 when quantized.
+		unsigned char reserved[20];				// Zero filled space for later versions.
+	};
+
+	// This class saves a built source surface to a file, and maps one
+	// so any number of processes sample the same read-only surface
+	// without triangulating it or building its search tree again.
+	class SourceFile
+	{
+		public:
+			SourceFile(){};							// SourceFile class constructor.
+			~SourceFile(){};						// SourceFile class deconstructor.
+			bool save(const char*,					// Writes a built surface to a file,
+					  const WeightedSurface&);		// returns false on failure.
+			bool open(const char*);					// Maps a built source file, returns false on failure.
+			const WeightedSurface& get_surface() const;	// Returns the surface sampling the mapped file.
+			const std::string& get_error() const;	// Returns the description of the last error.
+
+		private:
+			bool fail(const std::string&);			// Stores an error message and returns false.
+
+			MappedFile file;						// The memory-mapped source file.
+			WeightedSurface surface;				// The surface referring to the mapped arrays.
+			std::string error;						// The description of the last error.
+	};
+
+	size_t get_source_layout(const SourceFileHeader&,	// Computes the offset and size of every array in
+							 size_t*,					// a built source file and returns the file size.
+							 size_t*);
+}
+
+#endif // end if undefined __SOURCE_FILE__
@@ -0,0 +1,150 @@
+
+#include <thread>
+
+#include <systemInfo.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <errno.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char** environ;
+#endif
+
+namespace WeightTransferTool
+{
+	// Returns the peak resident set size of this process in bytes.
+	size_t get_peak_resident_size()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return (size_t)counters.PeakWorkingSetSize;
+#else
+		struct rusage usage;
+		if(getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#ifdef __APPLE__
+		// macOS reports the maximum resident size in bytes
+		return (size_t)usage.ru_maxrss;
+#else
+		// Linux reports the maximum resident size in kilobytes
+		return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+	}
+
+	// Returns the number of hardware threads, at least one.
+	unsigned get_processor_count()
+	{
+		unsigned count = std::thread::hardware_concurrency();
+		return count > 0 ? count : 1;
+	}
+
+#ifdef _WIN32
+	// Quotes a command-line argument for CreateProcess.
+	static std::string quote_argument(const std::string& arg)
+	{
+		if(!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+			return arg;
+		std::string quoted("\"");
+		unsigned backslashes = 0;
+		for(size_t i = 0; i < arg.size(); i++)
+		{
+			if(arg[i] == '\\')
+			{
+				backslashes++;
+				continue;
+			}
+			// backslashes are only escaped in front of a quote
+			quoted.append(arg[i] == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+			quoted += arg[i];
+			backslashes = 0;
+		}
+		quoted.append(backslashes * 2, '\\');
+		return quoted + "\"";
+	}
+#endif
+
+	// Starts one process for every argument list, the first argument being the program,
+	// and waits for all of them.  Returns false with an error if any process fails.
+	bool run_processes(const std::vector<std::vector<std::string> >& commands, std::string& error)
+	{
+		bool succeeded = true;
+#ifdef _WIN32
+		std::vector<HANDLE> processes;
+		for(size_t i = 0; i < commands.size(); i++)
+		{
+			std::string command_line;
+			for(size_t j = 0; j < commands[i].size(); j++)
+				command_line += (j > 0 ? " " : "") + quote_argument(commands[i][j]);
+			std::vector<char> buffer(command_line.begin(), command_line.end());
+			buffer.push_back('\0');
+
+			STARTUPINFOA startup_info;
+			PROCESS_INFORMATION process_info;
+			ZeroMemory(&startup_info, sizeof(startup_info));
+			startup_info.cb = sizeof(startup_info);
+			if(!CreateProcessA(NULL, &buffer[0], NULL, NULL, TRUE, 0, NULL, NULL, &startup_info, &process_info))
+			{
+				error = "Unable to start process: " + command_line;
+				succeeded = false;
+				break;
+			}
+			CloseHandle(process_info.hThread);
+			processes.push_back(process_info.hProcess);
+		}
+		for(size_t i = 0; i < processes.size(); i++)
+		{
+			DWORD exit_code = 1;
+			WaitForSingleObject(processes[i], INFINITE);
+			GetExitCodeProcess(processes[i], &exit_code);
+			CloseHandle(processes[i]);
+			if(exit_code != 0 && succeeded)
+			{
+				error = "A worker process failed: " + commands[i][0];
+				succeeded = false;
+			}
+		}
+#else
+		std::vector<pid_t> processes;
+		for(size_t i = 0; i < commands.size(); i++)
+		{
+			std::vector<char*> argv;
+			for(size_t j = 0; j < commands[i].size(); j++)
+				argv.push_back((char*)commands[i][j].c_str());
+			argv.push_back(NULL);
+
+			pid_t pid;
+			if(posix_spawnp(&pid, argv[0], NULL, NULL, &argv[0], environ) != 0)
+			{
+				error = "Unable to start process: " + commands[i][0];
+				succeeded = false;
+				break;
+			}
+			processes.push_back(pid);
+		}
+		// every started process is waited for, even after a failure
+		for(size_t i = 0; i < processes.size(); i++)
+		{
+			int status = 0;
+			pid_t result;
+			while((result = waitpid(processes[i], &status, 0)) < 0 && errno == EINTR)
+				;
+			bool exited = result == processes[i] && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+			if(!exited && succeeded)
+			{
+				error = "A worker process failed: " + commands[i][0];
+				succeeded = false;
+			}
+		}
+#endif
+		return succeeded;
+	}
+} // end namespace WeightTransferTool
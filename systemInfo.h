@@ -0,0 +1,17 @@
+#ifndef __SYSTEM_INFO__
+#define __SYSTEM_INFO__
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace WeightTransferTool
+{
+	size_t get_peak_resident_size();			// Returns the peak resident set size of this process in bytes.
+	unsigned get_processor_count();				// Returns the number of hardware threads, at least one.
+	bool run_processes(const std::vector<std::vector<std::string> >&,	// Starts one process for every argument list,
+					   std::string&);			// the first argument being the program, and waits for all of
+												// them.  Returns false with an error if any process fails.
+}
+
+#endif // end if undefined __SYSTEM_INFO__
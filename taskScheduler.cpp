@@ -0,0 +1,236 @@
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include <taskScheduler.h>
+
+namespace WeightTransferTool
+{
+	// TaskScheduler class constructor.  Every thread but the
+	// first is started here and waits for the tasks of a run.
+	TaskScheduler::TaskScheduler(unsigned thread_count)
+		: queues(thread_count > 0 ? thread_count : 1),
+		  run_task(NULL),
+		  run_number(0),
+		  busy_worker_count(0),
+		  stopping(false)
+	{
+		ThreadStats empty_stats = {0.0, 0, 0};
+		thread_stats.assign(queues.size(), empty_stats);
+		for(unsigned t = 1; t < queues.size(); t++)
+			workers.push_back(std::thread(&TaskScheduler::run_worker, this, t));
+	}
+
+	// TaskScheduler class deconstructor.  Stops and joins the started threads.
+	TaskScheduler::~TaskScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> guard(run_lock);
+			stopping = true;
+		}
+		run_ready.notify_all();
+		for(unsigned t = 0; t < workers.size(); t++)
+			workers[t].join();
+	}
+
+	// Runs the given number of tasks and waits for all of them.  Every
+	// thread is given a contiguous block of the tasks to begin with, then
+	// the started threads are woken and the calling thread runs its own.
+	void TaskScheduler::run(unsigned task_count, const TaskFunction& task)
+	{
+		unsigned thread_count = (unsigned)queues.size();
+		for(unsigned t = 0; t < thread_count; t++)
+		{
+			unsigned start = (unsigned)((unsigned long long)task_count * t / thread_count);
+			unsigned end = (unsigned)((unsigned long long)task_count * (t + 1) / thread_count);
+			queues[t].tasks.clear();
+			for(unsigned i = start; i < end; i++)
+				queues[t].tasks.push_back(i);
+		}
+
+		if(!workers.empty())
+		{
+			std::lock_guard<std::mutex> guard(run_lock);
+			run_task = &task;
+			busy_worker_count = (unsigned)workers.size();
+			run_number++;
+		}
+		run_ready.notify_all();
+
+		// the task must outlive the run, so the workers are waited for even if it throws
+		try
+		{
+			run_thread(0, task);
+		}
+		catch(...)
+		{
+			wait_for_workers();
+			throw;
+		}
+		wait_for_workers();
+	}
+
+	// Runs the tasks of every run on a started thread until stopped.
+	void TaskScheduler::run_worker(unsigned thread)
+	{
+		unsigned long long last_run = 0;
+		for(;;)
+		{
+			const TaskFunction* task;
+			{
+				std::unique_lock<std::mutex> guard(run_lock);
+				run_ready.wait(guard, [&]() { return stopping || run_number != last_run; });
+				if(stopping)
+					return;
+				last_run = run_number;
+				task = run_task;
+			}
+
+			run_thread(thread, *task);
+			{
+				std::lock_guard<std::mutex> guard(run_lock);
+				if(--busy_worker_count == 0)
+					run_done.notify_one();
+			}
+		}
+	}
+
+	// Waits until the started threads have finished the current run.
+	void TaskScheduler::wait_for_workers()
+	{
+		std::unique_lock<std::mutex> guard(run_lock);
+		run_done.wait(guard, [&]() { return busy_worker_count == 0; });
+	}
+
+	// Runs tasks on one thread until none are left.  No tasks are added
+	// while running, so once every queue is seen empty the thread is done.
+	void TaskScheduler::run_thread(unsigned thread, const TaskFunction& task)
+	{
+		ThreadStats& stats = thread_stats[thread];
+		unsigned index;
+		for(;;)
+		{
+			if(!pop_task(thread, index))
+			{
+				if(!steal_task(thread, index))
+					break;
+				stats.steal_count++;
+			}
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			task(index, thread);
+			stats.busy_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			stats.task_count++;
+		}
+	}
+
+	// Takes the next task from the front of a thread's own queue.
+	bool TaskScheduler::pop_task(unsigned thread, unsigned& index)
+	{
+		TaskQueue& queue = queues[thread];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if(queue.tasks.empty())
+			return false;
+		index = queue.tasks.front();
+		queue.tasks.pop_front();
+		return true;
+	}
+
+	// Takes a task from the back of another thread's queue, trying the
+	// following threads in turn so thieves spread over different victims.
+	bool TaskScheduler::steal_task(unsigned thread, unsigned& index)
+	{
+		unsigned thread_count = (unsigned)queues.size();
+		for(unsigned i = 1; i < thread_count; i++)
+		{
+			TaskQueue& queue = queues[(thread + i) % thread_count];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if(queue.tasks.empty())
+				continue;
+			index = queue.tasks.back();
+			queue.tasks.pop_back();
+			return true;
+		}
+		return false;
+	}
+
+	// Returns the number of threads tasks are run on.
+	unsigned TaskScheduler::get_thread_count() const
+	{
+		return (unsigned)queues.size();
+	}
+
+	// Returns the statistics of every thread, accumulated over every run.
+	const std::vector<ThreadStats>& TaskScheduler::get_thread_stats() const
+	{
+		return thread_stats;
+	}
+
+	// the scheduler shared by parallel loops, freed by shutdown_parallel_for rather than as the process exits
+	static TaskScheduler* shared_scheduler = NULL;
+	// set while a parallel loop runs on the shared scheduler
+	static std::atomic<bool> shared_scheduler_busy(false);
+
+	// Runs a function over consecutive ranges of PARALLEL_GRAIN_SIZE indices
+	// of a loop, spread over the given number of threads.  Short loops and
+	// single threads run the whole range on the calling thread.  The loops
+	// share one scheduler whose threads are kept between loops, and it is
+	// only started again when a loop asks for a different number of threads.
+	// A loop started while another uses it, from another thread or from
+	// inside one of its tasks, runs on a scheduler of its own.
+	void parallel_for(unsigned count, unsigned thread_count, const RangeFunction& function)
+	{
+		unsigned task_count = (count + PARALLEL_GRAIN_SIZE - 1) / PARALLEL_GRAIN_SIZE;
+		if(thread_count <= 1 || task_count <= 1)
+		{
+			if(count > 0)
+				function(0, count);
+			return;
+		}
+		TaskFunction task = [&](unsigned task_index, unsigned)
+		{
+			unsigned start = task_index * PARALLEL_GRAIN_SIZE;
+			function(start, std::min(count, start + PARALLEL_GRAIN_SIZE));
+		};
+
+		bool expected = false;
+		if(!shared_scheduler_busy.compare_exchange_strong(expected, true))
+		{
+			TaskScheduler scheduler(std::min(thread_count, task_count));
+			scheduler.run(task_count, task);
+			return;
+		}
+		try
+		{
+			if(shared_scheduler == NULL || shared_scheduler->get_thread_count() != thread_count)
+			{
+				delete shared_scheduler;
+				shared_scheduler = NULL;
+				shared_scheduler = new TaskScheduler(thread_count);
+			}
+			shared_scheduler->run(task_count, task);
+		}
+		catch(...)
+		{
+			shared_scheduler_busy.store(false);
+			throw;
+		}
+		shared_scheduler_busy.store(false);
+	}
+
+	// Stops the threads kept for parallel loops, waiting for a loop running on them to finish.  A
+	// plug-in calls this before it is unloaded, so no threads are left running its unloaded code.
+	void shutdown_parallel_for()
+	{
+		bool expected = false;
+		while(!shared_scheduler_busy.compare_exchange_weak(expected, true))
+		{
+			expected = false;
+			std::this_thread::yield();
+		}
+		delete shared_scheduler;
+		shared_scheduler = NULL;
+		shared_scheduler_busy.store(false);
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,79 @@
+#ifndef __TASK_SCHEDULER__
+#define __TASK_SCHEDULER__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WeightTransferTool
+{
+	// Load balance statistics of one scheduler thread.
+	struct ThreadStats
+	{
+		double busy_seconds;					// The time spent running tasks.
+		unsigned task_count;					// The number of tasks run.
+		unsigned steal_count;					// The number of tasks taken from another thread's queue.
+	};
+
+	// the function run for every task, given the task index and the index of the thread running it
+	typedef std::function<void(unsigned, unsigned)> TaskFunction;
+	// the function run for every range of a parallel loop, given the first and end index of the range
+	typedef std::function<void(unsigned, unsigned)> RangeFunction;
+
+	// the number of loop iterations run per task by parallel_for
+	const unsigned PARALLEL_GRAIN_SIZE = 16384;
+
+	// This class runs numbered tasks over a fixed number of threads.  Every
+	// thread starts with a contiguous block of the tasks in its own queue and
+	// runs them from the front.  A thread whose queue is empty steals from the
+	// back of another thread's queue, so neighbouring tasks stay on one thread
+	// until the load has to be rebalanced.  The calling thread runs tasks as
+	// the first thread, the others are started once and wait for every run.
+	class TaskScheduler
+	{
+		public:
+			TaskScheduler(unsigned);				// TaskScheduler class constructor.
+			~TaskScheduler();						// TaskScheduler class deconstructor.
+			void run(unsigned, const TaskFunction&);	// Runs the given number of tasks and waits for all of them.
+			unsigned get_thread_count() const;		// Returns the number of threads tasks are run on.
+			const std::vector<ThreadStats>& get_thread_stats() const;	// Returns the statistics of every thread,
+														// accumulated over every run.
+
+		private:
+			// The tasks waiting to be run by one thread.
+			struct TaskQueue
+			{
+				std::mutex lock;					// Guards the task indices.
+				std::deque<unsigned> tasks;			// The indices of the waiting tasks.
+			};
+
+			TaskScheduler(const TaskScheduler&);	// Schedulers own their threads and are not copied.
+			TaskScheduler& operator=(const TaskScheduler&);
+
+			void run_worker(unsigned);				// Runs the tasks of every run on a started thread until stopped.
+			void wait_for_workers();				// Waits until the started threads have finished the current run.
+			void run_thread(unsigned, const TaskFunction&);	// Runs tasks on one thread until none are left.
+			bool pop_task(unsigned, unsigned&);		// Takes the next task from the front of a thread's own queue.
+			bool steal_task(unsigned, unsigned&);	// Takes a task from the back of another thread's queue.
+
+			std::vector<TaskQueue> queues;			// The task queue of every thread.
+			std::vector<ThreadStats> thread_stats;	// The statistics of every thread.
+			std::vector<std::thread> workers;		// The started threads, every thread but the first.
+			std::mutex run_lock;					// Guards the run state below.
+			std::condition_variable run_ready;		// Signals the started threads a new run or to stop.
+			std::condition_variable run_done;		// Signals the calling thread the started threads are done.
+			const TaskFunction* run_task;			// The function of the current run.
+			unsigned long long run_number;			// The number of runs started, so threads see a new one.
+			unsigned busy_worker_count;				// The started threads still running the current run.
+			bool stopping;							// Set when the scheduler is destroyed.
+	};
+
+	void parallel_for(unsigned, unsigned,		// Runs a function over consecutive ranges of a loop's
+					  const RangeFunction&);	// indices, spread over the given number of threads.
+	void shutdown_parallel_for();				// Stops the threads kept for parallel loops.
+}
+
+#endif // end if undefined __TASK_SCHEDULER__
@@ -0,0 +1,441 @@
+
+#include <algorithm>
+#include <float.h>
+
+#include <triangleTree.h>
+#include <weightedSurface.h>
+#include <taskScheduler.h>
+
+namespace WeightTransferTool
+{
+	// Rounds a coordinate down to the nearest float.
+	static inline float round_down(double value)
+	{
+		float result = (float)value;
+		if((double)result > value)
+			result = nextafterf(result, -FLT_MAX);
+		return result;
+	}
+
+	// Rounds a coordinate up to the nearest float.
+	static inline float round_up(double value)
+	{
+		float result = (float)value;
+		if((double)result < value)
+			result = nextafterf(result, FLT_MAX);
+		return result;
+	}
+
+	// Returns the component of a point along an axis.
+	static inline double get_axis(const Point3d& point, unsigned axis)
+	{
+		return axis == 0 ? point.x : (axis == 1 ? point.y : point.z);
+	}
+
+	// Returns the squared distance from a point to a node's bounding box.
+	static inline double box_distance_sq(const TreeNode& node, const Point3d& point)
+	{
+		double distance_sq = 0.0;
+		for(unsigned axis = 0; axis < 3; axis++)
+		{
+			double value = get_axis(point, axis);
+			double delta = 0.0;
+			if(value < node.min[axis])
+				delta = node.min[axis] - value;
+			else if(value > node.max[axis])
+				delta = value - node.max[axis];
+			distance_sq += delta * delta;
+		}
+		return distance_sq;
+	}
+
+	// Returns the squared distance between two points.
+	static inline double distance_sq(const Point3d& p0, const Point3d& p1)
+	{
+		double dx = p0.x - p1.x;
+		double dy = p0.y - p1.y;
+		double dz = p0.z - p1.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// Orders triangle indices by their centroid along one axis.
+	struct CentroidLess
+	{
+		const std::vector<Point3d>* centroids;
+		unsigned axis;
+		bool operator()(unsigned a, unsigned b) const
+		{
+			return get_axis((*centroids)[a], axis) < get_axis((*centroids)[b], axis);
+		}
+	};
+
+	// TriangleTree class constructor.
+	TriangleTree::TriangleTree()
+	{
+		nodes = NULL;
+		node_count = 0;
+		tri_order = NULL;
+	}
+
+	// Returns the number of nodes below a node over the given number of triangles.
+	// Nodes are split at the median, so the count only depends on the number of
+	// triangles, and each level of the tree holds at most two different counts.
+	static unsigned count_descendants(unsigned tri_count, std::map<unsigned, unsigned>& counts)
+	{
+		if(tri_count <= TREE_LEAF_SIZE)
+			return 0;
+		std::map<unsigned, unsigned>::iterator found = counts.find(tri_count);
+		if(found != counts.end())
+			return found->second;
+		unsigned half = tri_count / 2;
+		unsigned count = 2 + count_descendants(half, counts) + count_descendants(tri_count - half, counts);
+		counts[tri_count] = count;
+		return count;
+	}
+
+	// Builds the tree over an array of triangles, spread over the given number
+	// of threads.  The top levels are split on this thread until there are a few
+	// subtrees per thread, which are then built concurrently.  Every subtree is
+	// given the node range a depth first build would allocate to it, so the tree
+	// is the same whatever the number of threads.
+	void TriangleTree::build(const Point3d* positions,
+							 const WeightedTriangle* tris,
+							 unsigned tri_count,
+							 unsigned thread_count)
+	{
+		owned_nodes.clear();
+		owned_tri_order.resize(tri_count);
+		nodes = NULL;
+		node_count = 0;
+		tri_order = owned_tri_order.data();
+		if(tri_count == 0)
+			return;
+
+		std::vector<Point3d> centroids(tri_count);
+		parallel_for(tri_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			for(unsigned i = start; i < end; i++)
+			{
+				const Point3d& p0 = positions[tris[i].v0];
+				const Point3d& p1 = positions[tris[i].v1];
+				const Point3d& p2 = positions[tris[i].v2];
+				centroids[i].x = (p0.x + p1.x + p2.x) / 3.0;
+				centroids[i].y = (p0.y + p1.y + p2.y) / 3.0;
+				centroids[i].z = (p0.z + p1.z + p2.z) / 3.0;
+				owned_tri_order[i] = i;
+			}
+		});
+
+		std::map<unsigned, unsigned> descendant_counts;
+		owned_nodes.resize(1 + count_descendants(tri_count, descendant_counts));
+		unsigned split_depth = 0;
+		while(thread_count > 1 && (1u << split_depth) < thread_count * 4)
+			split_depth++;
+		std::vector<SubtreeTask> subtrees;
+		split_top(0, 0, tri_count, 1, split_depth, centroids, descendant_counts, subtrees);
+
+		TaskScheduler scheduler(std::min(thread_count, (unsigned)subtrees.size()));
+		scheduler.run((unsigned)subtrees.size(), [&](unsigned task, unsigned)
+		{
+			const SubtreeTask& subtree = subtrees[task];
+			unsigned next_free = subtree.first_free;
+			build_node(subtree.node, subtree.start, subtree.end, next_free, positions, tris, centroids);
+		});
+		merge_bounds(0, split_depth);
+
+		nodes = owned_nodes.data();
+		node_count = (unsigned)owned_nodes.size();
+	}
+
+	// Orders a range of the triangle order around the median centroid along
+	// the largest extent of its centroids and returns the median.
+	unsigned TriangleTree::split_range(unsigned start, unsigned end, const std::vector<Point3d>& centroids)
+	{
+		double centroid_min[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+		double centroid_max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+		for(unsigned i = start; i < end; i++)
+			for(unsigned axis = 0; axis < 3; axis++)
+			{
+				double value = get_axis(centroids[owned_tri_order[i]], axis);
+				centroid_min[axis] = std::min(centroid_min[axis], value);
+				centroid_max[axis] = std::max(centroid_max[axis], value);
+			}
+		unsigned split_axis = 0;
+		for(unsigned axis = 1; axis < 3; axis++)
+			if(centroid_max[axis] - centroid_min[axis] > centroid_max[split_axis] - centroid_min[split_axis])
+				split_axis = axis;
+
+		unsigned middle = start + (end - start) / 2;
+		CentroidLess less = {&centroids, split_axis};
+		std::nth_element(owned_tri_order.begin() + start, owned_tri_order.begin() + middle,
+						 owned_tri_order.begin() + end, less);
+		return middle;
+	}
+
+	// Recursively splits a node's range of the triangle order and computes its
+	// bounds.  Child nodes are allocated in pairs from the next free node index.
+	void TriangleTree::build_node(unsigned node_index, unsigned start, unsigned end,
+								  unsigned& next_free,
+								  const Point3d* positions,
+								  const WeightedTriangle* tris,
+								  const std::vector<Point3d>& centroids)
+	{
+		unsigned count = end - start;
+		if(count <= TREE_LEAF_SIZE)
+		{
+			// the leaf bounds enclose every vertex of its triangles
+			double leaf_min[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+			double leaf_max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+			for(unsigned i = start; i < end; i++)
+			{
+				const WeightedTriangle& tri = tris[owned_tri_order[i]];
+				unsigned corners[3] = {tri.v0, tri.v1, tri.v2};
+				for(unsigned j = 0; j < 3; j++)
+					for(unsigned axis = 0; axis < 3; axis++)
+					{
+						double value = get_axis(positions[corners[j]], axis);
+						leaf_min[axis] = std::min(leaf_min[axis], value);
+						leaf_max[axis] = std::max(leaf_max[axis], value);
+					}
+			}
+
+			TreeNode& leaf = owned_nodes[node_index];
+			for(unsigned axis = 0; axis < 3; axis++)
+			{
+				leaf.min[axis] = round_down(leaf_min[axis]);
+				leaf.max[axis] = round_up(leaf_max[axis]);
+			}
+			leaf.first = start;
+			leaf.count = count;
+			return;
+		}
+
+		// split at the median along the largest centroid extent
+		unsigned middle = split_range(start, end, centroids);
+
+		// the children are allocated next to each other
+		unsigned first_child = next_free;
+		next_free += 2;
+		build_node(first_child, start, middle, next_free, positions, tris, centroids);
+		build_node(first_child + 1, middle, end, next_free, positions, tris, centroids);
+
+		const TreeNode& left = owned_nodes[first_child];
+		const TreeNode& right = owned_nodes[first_child + 1];
+		TreeNode& node = owned_nodes[node_index];
+		for(unsigned axis = 0; axis < 3; axis++)
+		{
+			node.min[axis] = std::min(left.min[axis], right.min[axis]);
+			node.max[axis] = std::max(left.max[axis], right.max[axis]);
+		}
+		node.first = first_child;
+		node.count = 0;
+	}
+
+	// Splits the top levels of the tree down to the given depth and lists the
+	// subtrees below them.  The right child's subtree starts after every node
+	// of the left child's subtree, as it would in a depth first build.
+	void TriangleTree::split_top(unsigned node_index, unsigned start, unsigned end,
+								 unsigned first_free, unsigned depth,
+								 const std::vector<Point3d>& centroids,
+								 std::map<unsigned, unsigned>& descendant_counts,
+								 std::vector<SubtreeTask>& subtrees)
+	{
+		if(depth == 0 || end - start <= TREE_LEAF_SIZE)
+		{
+			SubtreeTask subtree = {node_index, start, end, first_free};
+			subtrees.push_back(subtree);
+			return;
+		}
+
+		unsigned middle = split_range(start, end, centroids);
+		split_top(first_free, start, middle, first_free + 2, depth - 1,
+				  centroids, descendant_counts, subtrees);
+		split_top(first_free + 1, middle, end, first_free + 2 + count_descendants(middle - start, descendant_counts),
+				  depth - 1, centroids, descendant_counts, subtrees);
+		owned_nodes[node_index].first = first_free;
+		owned_nodes[node_index].count = 0;
+	}
+
+	// Computes the bounds of the nodes split by split_top from their children,
+	// once the subtrees below them are built.
+	void TriangleTree::merge_bounds(unsigned node_index, unsigned depth)
+	{
+		TreeNode& node = owned_nodes[node_index];
+		if(depth == 0 || node.count > 0)
+			return;
+		merge_bounds(node.first, depth - 1);
+		merge_bounds(node.first + 1, depth - 1);
+		const TreeNode& left = owned_nodes[node.first];
+		const TreeNode& right = owned_nodes[node.first + 1];
+		for(unsigned axis = 0; axis < 3; axis++)
+		{
+			node.min[axis] = std::min(left.min[axis], right.min[axis]);
+			node.max[axis] = std::max(left.max[axis], right.max[axis]);
+		}
+	}
+
+	// Finds the closest point on any triangle to the sample point within the maximum distance.
+	bool TriangleTree::find_closest(const Point3d* positions,
+									const WeightedTriangle* tris,
+									const Point3d& sample_point,
+									double max_distance,
+									unsigned& out_tri,
+									Point3d& out_closest) const
+	{
+		if(node_count == 0)
+			return false;
+
+		double best_distance_sq = max_distance < 0.0 ? DBL_MAX : max_distance * max_distance;
+		bool found = false;
+
+		// Nodes are visited nearest first and skipped once
+		// they are further away than the best triangle so far.
+		unsigned stack[MAX_TREE_DEPTH * 2];
+		double stack_distance[MAX_TREE_DEPTH * 2];
+		unsigned stack_size = 0;
+		stack[stack_size] = 0;
+		stack_distance[stack_size] = box_distance_sq(nodes[0], sample_point);
+		stack_size++;
+
+		while(stack_size > 0)
+		{
+			stack_size--;
+			if(stack_distance[stack_size] > best_distance_sq)
+				continue;
+			const TreeNode& node = nodes[stack[stack_size]];
+
+			if(node.count > 0)
+			{
+				for(unsigned i = node.first; i < node.first + node.count; i++)
+				{
+					const WeightedTriangle& tri = tris[tri_order[i]];
+					Point3d closest = closest_point_on_triangle(sample_point, positions[tri.v0],
+																positions[tri.v1], positions[tri.v2]);
+					double tri_distance_sq = distance_sq(sample_point, closest);
+					// Ties keep the lowest triangle index so the result
+					// does not depend on the order of the leaves.
+					if(tri_distance_sq < best_distance_sq ||
+					   (found && tri_distance_sq == best_distance_sq && tri_order[i] < out_tri))
+					{
+						best_distance_sq = tri_distance_sq;
+						out_tri = tri_order[i];
+						out_closest = closest;
+						found = true;
+					}
+				}
+				continue;
+			}
+
+			double left_distance = box_distance_sq(nodes[node.first], sample_point);
+			double right_distance = box_distance_sq(nodes[node.first + 1], sample_point);
+			// push the further child first so the nearer one is visited next
+			if(left_distance <= right_distance)
+			{
+				stack[stack_size] = node.first + 1;
+				stack_distance[stack_size++] = right_distance;
+				stack[stack_size] = node.first;
+				stack_distance[stack_size++] = left_distance;
+			}
+			else
+			{
+				stack[stack_size] = node.first;
+				stack_distance[stack_size++] = left_distance;
+				stack[stack_size] = node.first + 1;
+				stack_distance[stack_size++] = right_distance;
+			}
+		}
+		return found;
+	}
+
+	// Returns the number of bytes used by the tree.
+	size_t TriangleTree::get_memory_size() const
+	{
+		return owned_nodes.capacity() * sizeof(TreeNode) +
+			   owned_tri_order.capacity() * sizeof(unsigned);
+	}
+
+	// Returns the tree nodes and their number.
+	const TreeNode* TriangleTree::get_nodes(unsigned& count) const
+	{
+		count = node_count;
+		return nodes;
+	}
+
+	// Returns the triangle indices in leaf order.
+	const unsigned* TriangleTree::get_triangle_order() const
+	{
+		return tri_order;
+	}
+
+	// Searches external node and triangle order arrays instead of owned arrays.
+	void TriangleTree::set_buffers(const TreeNode* new_nodes, unsigned new_node_count,
+								   const unsigned* new_tri_order)
+	{
+		nodes = new_nodes;
+		node_count = new_node_count;
+		tri_order = new_tri_order;
+		std::vector<TreeNode>().swap(owned_nodes);
+		std::vector<unsigned>().swap(owned_tri_order);
+	}
+
+	// Returns the closest point on a triangle to a sample point.
+	Point3d closest_point_on_triangle(const Point3d& point,
+									  const Point3d& a,
+									  const Point3d& b,
+									  const Point3d& c)
+	{
+		// Find the Voronoi region of the triangle that contains
+		// the point and project it onto that vertex, edge or face.
+		Point3d ab = {b.x - a.x, b.y - a.y, b.z - a.z};
+		Point3d ac = {c.x - a.x, c.y - a.y, c.z - a.z};
+		Point3d ap = {point.x - a.x, point.y - a.y, point.z - a.z};
+		double d1 = ab.x * ap.x + ab.y * ap.y + ab.z * ap.z;
+		double d2 = ac.x * ap.x + ac.y * ap.y + ac.z * ap.z;
+		if(d1 <= 0.0 && d2 <= 0.0)
+			return a;
+
+		Point3d bp = {point.x - b.x, point.y - b.y, point.z - b.z};
+		double d3 = ab.x * bp.x + ab.y * bp.y + ab.z * bp.z;
+		double d4 = ac.x * bp.x + ac.y * bp.y + ac.z * bp.z;
+		if(d3 >= 0.0 && d4 <= d3)
+			return b;
+
+		double vc = d1 * d4 - d3 * d2;
+		if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		{
+			double v = d1 / (d1 - d3);
+			Point3d result = {a.x + ab.x * v, a.y + ab.y * v, a.z + ab.z * v};
+			return result;
+		}
+
+		Point3d cp = {point.x - c.x, point.y - c.y, point.z - c.z};
+		double d5 = ab.x * cp.x + ab.y * cp.y + ab.z * cp.z;
+		double d6 = ac.x * cp.x + ac.y * cp.y + ac.z * cp.z;
+		if(d6 >= 0.0 && d5 <= d6)
+			return c;
+
+		double vb = d5 * d2 - d1 * d6;
+		if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		{
+			double w = d2 / (d2 - d6);
+			Point3d result = {a.x + ac.x * w, a.y + ac.y * w, a.z + ac.z * w};
+			return result;
+		}
+
+		double va = d3 * d6 - d5 * d4;
+		if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+		{
+			double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			Point3d result = {b.x + (c.x - b.x) * w, b.y + (c.y - b.y) * w, b.z + (c.z - b.z) * w};
+			return result;
+		}
+
+		double denom = 1.0 / (va + vb + vc);
+		double v = vb * denom;
+		double w = vc * denom;
+		Point3d result = {a.x + ab.x * v + ac.x * w,
+						  a.y + ab.y * v + ac.y * w,
+						  a.z + ab.z * v + ac.z * w};
+		return result;
+	}
+} // end namespace WeightTransferTool
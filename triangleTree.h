@@ -0,0 +1,92 @@
+#ifndef __TRIANGLE_TREE__
+#define __TRIANGLE_TREE__
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+
+namespace WeightTransferTool
+{
+	struct Point3d;
+	class WeightedTriangle;
+
+	// the largest number of triangles stored in a tree leaf
+	const unsigned TREE_LEAF_SIZE = 4;
+	// the deepest tree a query can traverse
+	const unsigned MAX_TREE_DEPTH = 64;
+
+	// A node of the triangle tree.  Inner nodes store the index of their
+	// first child, the second child follows it.  Leaf nodes store a range
+	// of the tree's triangle order.
+	struct TreeNode
+	{
+		float min[3];							// The lower corner of the node's bounding box.
+		float max[3];							// The upper corner of the node's bounding box.
+		unsigned first;							// The first child node or the first triangle in the triangle order.
+		unsigned count;							// The number of triangles in a leaf node, zero for inner nodes.
+	};
+
+	// This class is a bounding volume hierarchy over the triangles of
+	// a surface which finds the closest point on the surface to a
+	// sample position.  It stores triangle indices only, the positions
+	// and triangles are passed in with every call.
+	class TriangleTree
+	{
+		public:
+			TriangleTree();							// TriangleTree class constructor.
+			~TriangleTree(){};						// TriangleTree class deconstructor.
+			void build(const Point3d*,				// Builds the tree over an array of triangles,
+					   const WeightedTriangle*,		// spread over the given number of threads.
+					   unsigned,
+					   unsigned);
+			bool find_closest(const Point3d*,		// Finds the closest point on any triangle to the sample
+							  const WeightedTriangle*,	// point within the maximum distance.  Returns false if
+							  const Point3d&,		// no triangle is close enough, a negative maximum
+							  double,				// distance means no limit.
+							  unsigned&,
+							  Point3d&) const;
+			size_t get_memory_size() const;			// Returns the number of bytes used by the tree.
+			const TreeNode* get_nodes(unsigned&) const;		// Returns the tree nodes and their number.
+			const unsigned* get_triangle_order() const;		// Returns the triangle indices in leaf order.
+			void set_buffers(const TreeNode*, unsigned,	// Searches external node and triangle order
+							 const unsigned*);		// arrays instead of owned arrays.
+
+		private:
+			// A subtree which is built by one thread, its nodes are allocated from first_free on.
+			struct SubtreeTask
+			{
+				unsigned node;						// The root node of the subtree.
+				unsigned start;						// The first entry of the subtree's triangle order range.
+				unsigned end;						// The end of the subtree's triangle order range.
+				unsigned first_free;				// The first node index allocated to the subtree.
+			};
+
+			unsigned split_range(unsigned, unsigned,	// Orders a range of the triangle order around the median
+								 const std::vector<Point3d>&);	// centroid along its largest extent and returns the median.
+			void build_node(unsigned, unsigned,		// Recursively splits a node's range of the
+							unsigned, unsigned&,	// triangle order and computes its bounds.
+							const Point3d*,
+							const WeightedTriangle*,
+							const std::vector<Point3d>&);
+			void split_top(unsigned, unsigned,		// Splits the top levels of the tree down to the given
+						   unsigned, unsigned,		// depth and lists the subtrees below them.
+						   unsigned,
+						   const std::vector<Point3d>&,
+						   std::map<unsigned, unsigned>&,
+						   std::vector<SubtreeTask>&);
+			void merge_bounds(unsigned, unsigned);	// Computes the bounds of the top levels from their children.
+
+			const TreeNode* nodes;					// The tree nodes, the root is the first node.
+			unsigned node_count;					// The number of tree nodes.
+			const unsigned* tri_order;				// The triangle indices in leaf order.
+			std::vector<TreeNode> owned_nodes;		// The nodes when they are not in an external buffer.
+			std::vector<unsigned> owned_tri_order;	// The triangle order when it is not in an external buffer.
+	};
+
+	Point3d closest_point_on_triangle(const Point3d&,	// Returns the closest point on a triangle
+									  const Point3d&,	// to a sample point.
+									  const Point3d&,
+									  const Point3d&);
+}
+
+#endif // end if undefined __TRIANGLE_TREE__
@@ -0,0 +1,193 @@
+
+#include <weightFile.h>
+
+namespace WeightTransferTool
+{
+	// the FNV-1a offset basis and prime the weight data hash is built from
+	const unsigned long long WEIGHT_HASH_BASIS = 14695981039346656037ULL;
+	const unsigned long long WEIGHT_HASH_PRIME = 1099511628211ULL;
+
+	static_assert(sizeof(WeightFileHeader) == WEIGHT_FILE_HEADER_SIZE, "WeightFileHeader must stay 64 bytes");
+
+	// Continues a weight data hash over the given number of values.  Whole
+	// 8-byte values are mixed in at a time to keep up with the disk.
+	unsigned long long hash_weights(unsigned long long hash, const double* values, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			unsigned long long word;
+			memcpy(&word, &values[i], sizeof(word));
+			hash = (hash ^ word) * WEIGHT_HASH_PRIME;
+		}
+		return hash;
+	}
+
+	// WeightFile class constructor.
+	WeightFile::WeightFile()
+	{
+		writing = false;
+		release_pages = false;
+		header_size = WEIGHT_FILE_HEADER_SIZE;
+		vertex_count = 0;
+		channel_count = 0;
+		vertices_written = 0;
+		released_offset = 0;
+		checksum = WEIGHT_HASH_BASIS;
+	}
+
+	// WeightFile class deconstructor.
+	WeightFile::~WeightFile()
+	{
+		close();
+	}
+
+	// Stores an error message and returns false.
+	bool WeightFile::fail(const std::string& message)
+	{
+		error = message;
+		file.close();
+		writing = false;
+		return false;
+	}
+
+	// Maps a weight file for reading and validates its
+	// header, and its checksum when requested.
+	bool WeightFile::open(const char* path, bool verify)
+	{
+		close();
+		if(!file.open(path))
+			return fail(std::string("Unable to open weight file: ") + path);
+
+		WeightFileHeader header;
+		if(file.get_size() < sizeof(header))
+			return fail(std::string("The weight file is too small: ") + path);
+		memcpy(&header, file.get_data(), sizeof(header));
+		if(memcmp(header.magic, WEIGHT_FILE_MAGIC, sizeof(header.magic)) != 0)
+			return fail(std::string("The file is not a weight file: ") + path);
+		if(header.version != WEIGHT_FILE_VERSION)
+			return fail(std::string("Unsupported weight file version: ") + path);
+		if(header.header_size < sizeof(header) || header.header_size % sizeof(double) != 0 ||
+		   header.channel_count == 0 || header.channel_count > WEIGHT_COUNT ||
+		   header.vertex_count > 0xFFFFFFFFULL)
+			return fail(std::string("The weight file header is invalid: ") + path);
+
+		size_t value_count = (size_t)header.vertex_count * header.channel_count;
+		if(file.get_size() != header.header_size + value_count * sizeof(double))
+			return fail(std::string("The weight file size does not match its header: ") + path);
+
+		header_size = header.header_size;
+		vertex_count = (unsigned)header.vertex_count;
+		channel_count = header.channel_count;
+		if(verify && hash_weights(WEIGHT_HASH_BASIS, get_weights(), value_count) != header.checksum)
+			return fail(std::string("The weight file checksum does not match: ") + path);
+		return true;
+	}
+
+	// Creates a weight file for the given number of vertices and weight values per vertex.
+	bool WeightFile::create(const char* path, unsigned new_vertex_count, unsigned new_channel_count)
+	{
+		close();
+		if(new_channel_count == 0 || new_channel_count > WEIGHT_COUNT)
+			return fail("The number of weight values per vertex must be between 1 and 4.");
+		size_t value_count = (size_t)new_vertex_count * new_channel_count;
+		if(!file.create(path, WEIGHT_FILE_HEADER_SIZE + value_count * sizeof(double)))
+			return fail(std::string("Unable to create weight file: ") + path);
+
+		writing = true;
+		header_size = WEIGHT_FILE_HEADER_SIZE;
+		vertex_count = new_vertex_count;
+		channel_count = new_channel_count;
+		vertices_written = 0;
+		released_offset = 0;
+		checksum = WEIGHT_HASH_BASIS;
+		return true;
+	}
+
+	// Writes the first channel_count weights out of every
+	// WEIGHT_COUNT values for the next vertices.
+	void WeightFile::write_weights(const double* weights, unsigned count)
+	{
+		if(!writing)
+			return;
+		if(count > vertex_count - vertices_written)
+			count = vertex_count - vertices_written;
+
+		size_t offset = WEIGHT_FILE_HEADER_SIZE + (size_t)vertices_written * channel_count * sizeof(double);
+		double* values = (double*)(file.get_writable_data() + offset);
+		for(unsigned i = 0; i < count; i++)
+			memcpy(&values[i * channel_count], &weights[i * WEIGHT_COUNT], sizeof(double) * channel_count);
+		checksum = hash_weights(checksum, values, (size_t)count * channel_count);
+		vertices_written += count;
+
+		// Written pages stay in the file once they leave the resident set.  Each call releases
+		// from where the last one stopped, so the page it only partly wrote goes too.
+		if(release_pages)
+		{
+			size_t end = offset + (size_t)count * channel_count * sizeof(double);
+			released_offset = file.release(released_offset, end - released_offset);
+		}
+	}
+
+	// Releases the pages of weights once they are written.
+	void WeightFile::set_release_pages(bool release)
+	{
+		release_pages = release;
+	}
+
+	// Finishes a created file, returns false if it is incomplete.
+	bool WeightFile::close()
+	{
+		if(!writing)
+		{
+			file.close();
+			return true;
+		}
+		writing = false;
+
+		// the header is written last so an incomplete file is never valid
+		WeightFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, WEIGHT_FILE_MAGIC, sizeof(header.magic));
+		header.version = WEIGHT_FILE_VERSION;
+		header.header_size = WEIGHT_FILE_HEADER_SIZE;
+		header.channel_count = channel_count;
+		header.vertex_count = vertex_count;
+		header.checksum = checksum;
+		if(vertices_written == vertex_count)
+			memcpy(file.get_writable_data(), &header, sizeof(header));
+		file.close();
+
+		if(vertices_written != vertex_count)
+		{
+			error = "Not every vertex was written to the weight file.";
+			return false;
+		}
+		return true;
+	}
+
+	// Returns the channel_count weights of every vertex.
+	const double* WeightFile::get_weights() const
+	{
+		if(file.get_data() == NULL)
+			return NULL;
+		return (const double*)(file.get_data() + header_size);
+	}
+
+	// Returns the number of vertices in the file.
+	unsigned WeightFile::get_vertex_count() const
+	{
+		return vertex_count;
+	}
+
+	// Returns the number of weight values per vertex.
+	unsigned WeightFile::get_channel_count() const
+	{
+		return channel_count;
+	}
+
+	// Returns the description of the last error.
+	const std::string& WeightFile::get_error() const
+	{
+		return error;
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,73 @@
+#ifndef __WEIGHT_FILE__
+#define __WEIGHT_FILE__
+
+#include <string>
+
+#include <weightedSurface.h>
+#include <mappedFile.h>
+
+namespace WeightTransferTool
+{
+	// the identifier at the start of a weight file
+	const char WEIGHT_FILE_MAGIC[4] = {'W', 'T', 'W', 'F'};
+	// the current weight file version
+	const unsigned WEIGHT_FILE_VERSION = 1;
+	// the size of the weight file header, which keeps the weight data aligned
+	const unsigned WEIGHT_FILE_HEADER_SIZE = 64;
+
+	// The header of a weight file.  It is followed at header_size bytes by
+	// channel_count doubles for every vertex, stored in the byte order of
+	// the machine which wrote it.  The checksum covers the weight data.
+	struct WeightFileHeader
+	{
+		char magic[4];							// The WEIGHT_FILE_MAGIC identifier.
+		unsigned version;						// The file format version.
+		unsigned header_size;					// The offset of the weight data in bytes.
+		unsigned channel_count;					// The number of weight values per vertex.
+		unsigned long long vertex_count;		// The number of vertices.
+		unsigned long long checksum;			// The hash of the weight data.
+		unsigned char reserved[32];				// Zero filled space for later versions.
+	};
+
+	// This class maps a weight file so its weights can be sampled
+	// directly, or creates one and writes weights into it sequentially.
+	class WeightFile
+	{
+		public:
+			WeightFile();							// WeightFile class constructor.
+			~WeightFile();							// WeightFile class deconstructor.
+			bool open(const char*, bool);			// Maps a weight file for reading and validates its header,
+													// and its checksum when requested.
+			bool create(const char*, unsigned,		// Creates a weight file for the given number of
+						unsigned);					// vertices and weight values per vertex.
+			void write_weights(const double*,		// Writes the first channel_count weights out of every
+							   unsigned);			// WEIGHT_COUNT values for the next vertices.
+			void set_release_pages(bool);			// Releases the pages of weights once they are written.
+			bool close();							// Finishes a created file, returns false if it is incomplete.
+
+			const double* get_weights() const;		// Returns the channel_count weights of every vertex.
+			unsigned get_vertex_count() const;		// Returns the number of vertices in the file.
+			unsigned get_channel_count() const;		// Returns the number of weight values per vertex.
+			const std::string& get_error() const;	// Returns the description of the last error.
+
+		private:
+			bool fail(const std::string&);			// Stores an error message and returns false.
+
+			MappedFile file;						// The memory-mapped weight file.
+			std::string error;						// The description of the last error.
+			bool writing;							// Indicates the file was created for writing.
+			bool release_pages;						// Indicates written weight pages are released.
+			unsigned header_size;					// The offset of the weight data in bytes.
+			unsigned vertex_count;					// The number of vertices in the file.
+			unsigned channel_count;					// The number of weight values per vertex.
+			unsigned vertices_written;				// The number of vertices written so far.
+			size_t released_offset;					// The file offset the next release of written pages starts at.
+			unsigned long long checksum;			// The running hash of the written weights.
+	};
+
+	unsigned long long hash_weights(unsigned long long,	// Continues a weight data hash over the
+									const double*,		// given number of values.
+									size_t);
+}
+
+#endif // end if undefined __WEIGHT_FILE__
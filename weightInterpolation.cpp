@@ -0,0 +1,28 @@
+
+#include <weightInterpolation.h>
+
+namespace WeightTransferTool
+{
+	// Reads an interpolation mode from its name, returns false if the name is unknown.
+	bool parse_interpolation_mode(const std::string& name, InterpolationMode& mode)
+	{
+		if(name == "linear")
+			mode = LINEAR_INTERPOLATION;
+		else if(name == "nearest")
+			mode = NEAREST_INTERPOLATION;
+		else if(name == "max")
+			mode = MAX_INTERPOLATION;
+		else if(name == "smooth")
+			mode = SMOOTH_INTERPOLATION;
+		else
+			return false;
+		return true;
+	}
+
+	// Returns true if the mode blends the corner weights linearly, by factors which
+	// depend on the sample position only.  The max mode compares the weights themselves.
+	bool is_linear_interpolation(InterpolationMode mode)
+	{
+		return mode != MAX_INTERPOLATION;
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,97 @@
+#ifndef __WEIGHT_INTERPOLATION__
+#define __WEIGHT_INTERPOLATION__
+
+#include <string.h>
+#include <string>
+
+namespace WeightTransferTool
+{
+	// The ways the weights of a triangle's corners are blended at a sample point.
+	// Each mode is implemented by a policy class below which the sample methods
+	// take as a template parameter, so every mode compiles to its own loop.
+	enum InterpolationMode
+	{
+		LINEAR_INTERPOLATION = 1,				// The corners are blended by their barycentric coordinates.
+		NEAREST_INTERPOLATION = 2,				// The weights of the closest corner are copied.
+		MAX_INTERPOLATION = 3,					// Every channel takes its largest value among the corners.
+		SMOOTH_INTERPOLATION = 4,				// The corners are blended by smoothstepped coordinates.
+	};
+
+	bool parse_interpolation_mode(const std::string&,	// Reads an interpolation mode from its name, returns
+								  InterpolationMode&);	// false if the name is unknown.
+	bool is_linear_interpolation(InterpolationMode);	// Returns true if the mode blends the corner weights
+														// linearly, by factors which do not depend on them.
+
+	// Blends the corner weights by their barycentric coordinates, so the
+	// weights vary linearly across the triangle.
+	struct LinearInterpolation
+	{
+		static void blend(const double* const* corner_weights, const double* bary_coords,
+						  unsigned channel_count, double* out_weights)
+		{
+			for(unsigned i = 0; i < channel_count; i++)
+				out_weights[i] = corner_weights[0][i] * bary_coords[0] +
+								 corner_weights[1][i] * bary_coords[1] +
+								 corner_weights[2][i] * bary_coords[2];
+		}
+	};
+
+	// Copies the weights of the corner with the largest barycentric coordinate,
+	// for values such as indices and labels which must not be blended.
+	struct NearestInterpolation
+	{
+		static void blend(const double* const* corner_weights, const double* bary_coords,
+						  unsigned channel_count, double* out_weights)
+		{
+			unsigned nearest = bary_coords[1] > bary_coords[0] ? 1 : 0;
+			if(bary_coords[2] > bary_coords[nearest])
+				nearest = 2;
+			memcpy(out_weights, corner_weights[nearest], sizeof(double) * channel_count);
+		}
+	};
+
+	// Gives every channel its largest value among the corners the sample point
+	// lies towards, so masks and influences are not diluted across a triangle.
+	// A corner whose barycentric coordinate is zero, which is the case on the
+	// opposite edge, does not contribute.
+	struct MaxInterpolation
+	{
+		static void blend(const double* const* corner_weights, const double* bary_coords,
+						  unsigned channel_count, double* out_weights)
+		{
+			unsigned first = bary_coords[0] > 0.0 ? 0 : (bary_coords[1] > 0.0 ? 1 : 2);
+			for(unsigned i = 0; i < channel_count; i++)
+			{
+				double value = corner_weights[first][i];
+				for(unsigned corner = first + 1; corner < 3; corner++)
+					if(bary_coords[corner] > 0.0 && corner_weights[corner][i] > value)
+						value = corner_weights[corner][i];
+				out_weights[i] = value;
+			}
+		}
+	};
+
+	// Blends the corner weights by smoothstepped barycentric coordinates, scaled
+	// to sum to one.  The weights ease out of every corner, so they are flat at
+	// the vertices and change across the middle of the triangle instead.
+	struct SmoothInterpolation
+	{
+		static void blend(const double* const* corner_weights, const double* bary_coords,
+						  unsigned channel_count, double* out_weights)
+		{
+			double factors[3];
+			double total = 0.0;
+			for(unsigned corner = 0; corner < 3; corner++)
+			{
+				double t = bary_coords[corner] < 0.0 ? 0.0 : (bary_coords[corner] > 1.0 ? 1.0 : bary_coords[corner]);
+				factors[corner] = t * t * (3.0 - 2.0 * t);
+				total += factors[corner];
+			}
+			for(unsigned corner = 0; corner < 3; corner++)
+				factors[corner] /= total;
+			LinearInterpolation::blend(corner_weights, factors, channel_count, out_weights);
+		}
+	};
+}
+
+#endif // end if undefined __WEIGHT_INTERPOLATION__
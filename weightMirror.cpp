@@ -0,0 +1,102 @@
+
+#include <string.h>
+
+#include <weightMirror.h>
+
+namespace WeightTransferTool
+{
+	// Returns the component of a point along an axis.
+	static inline double get_axis(const Point3d& point, unsigned axis)
+	{
+		return axis == 0 ? point.x : (axis == 1 ? point.y : point.z);
+	}
+
+	// Reads a mirror plane from the name of the two axes it spans, such as yz, returns
+	// false if the name is invalid.  The weights are mirrored from the positive side of
+	// the plane to the negative side, or the other way when inverse is set.
+	bool parse_mirror_plane(const std::string& name, bool inverse, MirrorPlane& plane)
+	{
+		if(name == "yz" || name == "YZ")
+			plane.axis = 0;
+		else if(name == "xz" || name == "XZ")
+			plane.axis = 1;
+		else if(name == "xy" || name == "XY")
+			plane.axis = 2;
+		else
+			return false;
+		plane.to_positive = inverse;
+		return true;
+	}
+
+	// MirrorStream class constructor, lists the vertices of the surface on the target
+	// side of the plane.  Vertices on the plane keep their weights, so the seam of a
+	// symmetric mesh is not changed.
+	MirrorStream::MirrorStream(const WeightedSurface& mirror_surface, const MirrorPlane& mirror_plane)
+		: surface(mirror_surface), plane(mirror_plane), read_index(0), read_count(0), write_index(0)
+	{
+		SurfaceBuffers buffers;
+		surface.get_buffers(buffers);
+		positions = buffers.positions;
+		for(unsigned i = 0; i < buffers.vertex_count; i++)
+		{
+			double side = get_axis(positions[i], plane.axis);
+			if(plane.to_positive ? side > EPSILON : side < -EPSILON)
+				targets.push_back(i);
+		}
+		target_weights.resize(targets.size() * WEIGHT_COUNT);
+	}
+
+	// Reads the next chunk of target positions, reflected across the plane.
+	unsigned MirrorStream::read_positions(Point3d* out_positions, unsigned max_count)
+	{
+		unsigned count = 0;
+		for(; count < max_count && read_index < targets.size(); count++)
+		{
+			Point3d& position = out_positions[count];
+			position = positions[targets[read_index++]];
+			if(plane.axis == 0)
+				position.x = -position.x;
+			else if(plane.axis == 1)
+				position.y = -position.y;
+			else
+				position.z = -position.z;
+		}
+		read_count = count;
+		return count;
+	}
+
+	// Reads the surface weights of the targets last read, so targets
+	// out of range of the mirrored side can keep their own weights.
+	bool MirrorStream::read_existing_weights(double* out_weights, unsigned count)
+	{
+		unsigned first = read_index - read_count;
+		for(unsigned i = 0; i < count; i++)
+			surface.copy_weights(targets[first + i], &out_weights[(size_t)i * WEIGHT_COUNT]);
+		return true;
+	}
+
+	// Keeps the weights of the positions last read.
+	void MirrorStream::write_weights(const double* weights, unsigned count)
+	{
+		memcpy(&target_weights[(size_t)write_index * WEIGHT_COUNT], weights, sizeof(double) * WEIGHT_COUNT * count);
+		write_index += count;
+	}
+
+	// Returns the number of target vertices.
+	unsigned MirrorStream::get_target_count() const
+	{
+		return (unsigned)targets.size();
+	}
+
+	// Returns the surface vertex index of a target.
+	unsigned MirrorStream::get_target(unsigned index) const
+	{
+		return targets[index];
+	}
+
+	// Returns the WEIGHT_COUNT mirrored weights of a target.
+	const double* MirrorStream::get_target_weights(unsigned index) const
+	{
+		return &target_weights[(size_t)index * WEIGHT_COUNT];
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,54 @@
+#ifndef __WEIGHT_MIRROR__
+#define __WEIGHT_MIRROR__
+
+#include <string>
+#include <vector>
+
+#include <weightedSurface.h>
+#include <weightStream.h>
+
+namespace WeightTransferTool
+{
+	// A plane through the origin which the weights of one side of a mesh are mirrored
+	// across.  Like Maya's mirror modes, the plane is named by the two axes it spans.
+	struct MirrorPlane
+	{
+		unsigned axis;							// The axis the plane is perpendicular to, 0 to 2 for x to z.
+		bool to_positive;						// Indicates the weights of the negative side are mirrored
+												// onto the positive side rather than the other way.
+	};
+
+	bool parse_mirror_plane(const std::string&,	// Reads a mirror plane from the name of the two axes it
+							bool, MirrorPlane&);	// spans, such as yz, returns false if the name is invalid.
+
+	// This stream reads the positions of the vertices on the target side of a mirror
+	// plane, reflected onto the source side, from the vertices of a surface and keeps
+	// the weights sampled for them.  Vertices within EPSILON of the plane are not targets.
+	class MirrorStream : public DestinationStream
+	{
+		public:
+			MirrorStream(const WeightedSurface&,	// MirrorStream class constructor, lists the target
+						 const MirrorPlane&);		// vertices of the surface.
+			~MirrorStream(){};						// MirrorStream class deconstructor.
+
+			unsigned read_positions(Point3d*, unsigned);	// Reads the next chunk of reflected target positions.
+			void write_weights(const double*, unsigned);	// Keeps the weights of the positions last read.
+			bool read_existing_weights(double*, unsigned);	// Reads the surface weights of the targets last read.
+
+			unsigned get_target_count() const;		// Returns the number of target vertices.
+			unsigned get_target(unsigned) const;	// Returns the surface vertex index of a target.
+			const double* get_target_weights(unsigned) const;	// Returns the WEIGHT_COUNT mirrored weights of a target.
+
+		private:
+			const WeightedSurface& surface;			// The surface the weights are mirrored on.
+			const Point3d* positions;				// The positions of the surface vertices.
+			MirrorPlane plane;						// The plane the weights are mirrored across.
+			std::vector<unsigned> targets;			// The surface vertex index of every target.
+			std::vector<double> target_weights;		// WEIGHT_COUNT mirrored weights for every target.
+			unsigned read_index;					// The index of the next target to read.
+			unsigned read_count;					// The number of targets last read.
+			unsigned write_index;					// The index of the next target to write.
+	};
+}
+
+#endif // end if undefined __WEIGHT_MIRROR__
@@ -0,0 +1,317 @@
+
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+#include <weightOperator.h>
+#include <taskScheduler.h>
+
+namespace WeightTransferTool
+{
+	static_assert(sizeof(OperatorFileHeader) == OPERATOR_FILE_ALIGNMENT, "OperatorFileHeader must stay 64 bytes");
+
+	// Rounds a file offset up to the array alignment.
+	static inline size_t align_offset(size_t offset)
+	{
+		return (offset + OPERATOR_FILE_ALIGNMENT - 1) / OPERATOR_FILE_ALIGNMENT * OPERATOR_FILE_ALIGNMENT;
+	}
+
+	// Computes the offset and size of every array in an operator file and returns the file size.
+	static size_t get_operator_layout(const OperatorFileHeader& header, size_t* offsets, size_t* sizes)
+	{
+		sizes[0] = ((size_t)header.row_count + 1) * sizeof(unsigned long long);
+		sizes[1] = (size_t)header.entry_count * sizeof(unsigned);
+		sizes[2] = (size_t)header.entry_count * sizeof(double);
+
+		size_t offset = sizeof(OperatorFileHeader);
+		for(unsigned i = 0; i < OPERATOR_SECTION_COUNT; i++)
+		{
+			offsets[i] = align_offset(offset);
+			offset = offsets[i] + sizes[i];
+		}
+		return offset;
+	}
+
+	// Lists the entries of a row of the second operator followed by the first,
+	// the entries of the first's rows scaled by the second's coefficients and
+	// summed per column.  The entries are merged in a fixed order so the sums
+	// do not depend on the thread count.  Columns which cancel out are left out.
+	static void compose_row(const WeightOperator& first, const WeightOperator& second, unsigned row,
+							std::vector<std::pair<unsigned, double> >& entries)
+	{
+		const unsigned long long* first_offsets = first.get_row_offsets();
+		const unsigned* first_columns = first.get_columns();
+		const double* first_coefficients = first.get_coefficients();
+		const unsigned long long* second_offsets = second.get_row_offsets();
+
+		entries.clear();
+		for(unsigned long long i = second_offsets[row]; i < second_offsets[row + 1]; i++)
+		{
+			unsigned middle = second.get_columns()[i];
+			double scale = second.get_coefficients()[i];
+			for(unsigned long long j = first_offsets[middle]; j < first_offsets[middle + 1]; j++)
+				entries.push_back(std::make_pair(first_columns[j], scale * first_coefficients[j]));
+		}
+		std::stable_sort(entries.begin(), entries.end(),
+						 [](const std::pair<unsigned, double>& a, const std::pair<unsigned, double>& b)
+						 {
+							 return a.first < b.first;
+						 });
+
+		size_t count = 0;
+		for(size_t i = 0; i < entries.size(); )
+		{
+			unsigned column = entries[i].first;
+			double sum = 0.0;
+			for(; i < entries.size() && entries[i].first == column; i++)
+				sum += entries[i].second;
+			if(sum != 0.0)
+				entries[count++] = std::make_pair(column, sum);
+		}
+		entries.resize(count);
+	}
+
+	// WeightOperator class constructor.
+	WeightOperator::WeightOperator()
+	{
+		reset(0);
+	}
+
+	// Clears the operator to no rows over the given number of columns.
+	void WeightOperator::reset(unsigned new_column_count)
+	{
+		file.close();
+		row_count = 0;
+		column_count = new_column_count;
+		owned_row_offsets.assign(1, 0);
+		owned_columns.clear();
+		owned_coefficients.clear();
+		use_owned_arrays();
+	}
+
+	// Points the arrays at the owned arrays.
+	void WeightOperator::use_owned_arrays()
+	{
+		row_offsets = owned_row_offsets.data();
+		columns = owned_columns.data();
+		coefficients = owned_coefficients.data();
+	}
+
+	// Appends a row with the given column indexes and coefficients.  The
+	// operator must have been built rather than mapped from a file.
+	void WeightOperator::append_row(const unsigned* row_columns, const double* row_coefficients, unsigned count)
+	{
+		owned_columns.insert(owned_columns.end(), row_columns, row_columns + count);
+		owned_coefficients.insert(owned_coefficients.end(), row_coefficients, row_coefficients + count);
+		owned_row_offsets.push_back(owned_columns.size());
+		row_count++;
+		use_owned_arrays();
+	}
+
+	// Multiplies source values with the given number of channels per vertex into
+	// destination values, spread over the given number of threads.  Every row is
+	// summed in its entry order, so the result does not depend on the thread count,
+	// and rows without entries are zero.  Each destination value is written once
+	// and the source values are read in place, so the product runs at the speed
+	// the arrays stream through memory.
+	void WeightOperator::apply(const double* values, unsigned channel_count, double* out_values,
+							   unsigned thread_count) const
+	{
+		parallel_for(row_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			for(unsigned row = start; row < end; row++)
+			{
+				double* out_row = &out_values[(size_t)row * channel_count];
+				for(unsigned c = 0; c < channel_count; c++)
+					out_row[c] = 0.0;
+				for(unsigned long long i = row_offsets[row]; i < row_offsets[row + 1]; i++)
+				{
+					const double* in_row = &values[(size_t)columns[i] * channel_count];
+					double coefficient = coefficients[i];
+					for(unsigned c = 0; c < channel_count; c++)
+						out_row[c] += coefficient * in_row[c];
+				}
+			}
+		});
+	}
+
+	// Replaces this operator with the first operator followed by the second, so a
+	// chain of transfers is applied as one.  The rows are composed twice over the
+	// given number of threads, once to count their entries and once to fill them
+	// in at the offsets found by a prefix sum.  Returns false if the first's rows
+	// are not the second's columns.
+	bool WeightOperator::compose(const WeightOperator& first, const WeightOperator& second, unsigned thread_count)
+	{
+		// either operator may be this one, so it is left as it is on failure
+		if(first.row_count != second.column_count)
+		{
+			error = "The rows of the first operator do not match the columns of the second.";
+			return false;
+		}
+
+		unsigned new_row_count = second.row_count;
+		std::vector<unsigned long long> new_row_offsets(new_row_count + 1, 0);
+		parallel_for(new_row_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			std::vector<std::pair<unsigned, double> > entries;
+			for(unsigned row = start; row < end; row++)
+			{
+				compose_row(first, second, row, entries);
+				new_row_offsets[row + 1] = entries.size();
+			}
+		});
+		for(unsigned row = 0; row < new_row_count; row++)
+			new_row_offsets[row + 1] += new_row_offsets[row];
+
+		std::vector<unsigned> new_columns(new_row_offsets[new_row_count]);
+		std::vector<double> new_coefficients(new_columns.size());
+		parallel_for(new_row_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			std::vector<std::pair<unsigned, double> > entries;
+			for(unsigned row = start; row < end; row++)
+			{
+				compose_row(first, second, row, entries);
+				for(size_t i = 0; i < entries.size(); i++)
+				{
+					new_columns[new_row_offsets[row] + i] = entries[i].first;
+					new_coefficients[new_row_offsets[row] + i] = entries[i].second;
+				}
+			}
+		});
+
+		// nothing is replaced until the rows are composed
+		unsigned new_column_count = first.column_count;
+		reset(new_column_count);
+		row_count = new_row_count;
+		owned_row_offsets.swap(new_row_offsets);
+		owned_columns.swap(new_columns);
+		owned_coefficients.swap(new_coefficients);
+		use_owned_arrays();
+		return true;
+	}
+
+	// Stores an error message, clears the operator and returns false.
+	bool WeightOperator::fail(const std::string& message)
+	{
+		error = message;
+		reset(0);
+		return false;
+	}
+
+	// Writes the operator to a file, returns false on failure.
+	bool WeightOperator::save(const char* path)
+	{
+		OperatorFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, OPERATOR_FILE_MAGIC, sizeof(header.magic));
+		header.version = OPERATOR_FILE_VERSION;
+		header.row_count = row_count;
+		header.column_count = column_count;
+		header.entry_count = get_entry_count();
+
+		size_t offsets[OPERATOR_SECTION_COUNT];
+		size_t sizes[OPERATOR_SECTION_COUNT];
+		size_t file_size = get_operator_layout(header, offsets, sizes);
+		MappedFile out_file;
+		if(!out_file.create(path, file_size))
+		{
+			error = std::string("Unable to create operator file: ") + path;
+			return false;
+		}
+
+		const void* arrays[OPERATOR_SECTION_COUNT] = {row_offsets, columns, coefficients};
+		// the padding between arrays is already zero in a new file
+		char* data = out_file.get_writable_data();
+		memcpy(data, &header, sizeof(header));
+		for(unsigned i = 0; i < OPERATOR_SECTION_COUNT; i++)
+			if(sizes[i] > 0)
+				memcpy(data + offsets[i], arrays[i], sizes[i]);
+		out_file.close();
+		return true;
+	}
+
+	// Maps an operator file, returns false on failure.  The row offsets and
+	// column indexes are checked so applying the operator never reads
+	// outside the source values.
+	bool WeightOperator::open(const char* path)
+	{
+		reset(0);
+		if(!file.open(path))
+			return fail(std::string("Unable to open operator file: ") + path);
+
+		OperatorFileHeader header;
+		if(file.get_size() < sizeof(header))
+			return fail(std::string("The operator file is too small: ") + path);
+		memcpy(&header, file.get_data(), sizeof(header));
+		if(memcmp(header.magic, OPERATOR_FILE_MAGIC, sizeof(header.magic)) != 0)
+			return fail(std::string("The file is not an operator file: ") + path);
+		if(header.version != OPERATOR_FILE_VERSION)
+			return fail(std::string("Unsupported operator file version: ") + path);
+
+		size_t offsets[OPERATOR_SECTION_COUNT];
+		size_t sizes[OPERATOR_SECTION_COUNT];
+		if(header.entry_count > file.get_size() || file.get_size() != get_operator_layout(header, offsets, sizes))
+			return fail(std::string("The operator file size does not match its header: ") + path);
+
+		const char* data = file.get_data();
+		const unsigned long long* file_row_offsets = (const unsigned long long*)(data + offsets[0]);
+		const unsigned* file_columns = (const unsigned*)(data + offsets[1]);
+		if(file_row_offsets[0] != 0 || file_row_offsets[header.row_count] != header.entry_count)
+			return fail(std::string("The operator file has invalid rows: ") + path);
+		for(unsigned row = 0; row < header.row_count; row++)
+			if(file_row_offsets[row + 1] < file_row_offsets[row])
+				return fail(std::string("The operator file has invalid rows: ") + path);
+		for(unsigned long long i = 0; i < header.entry_count; i++)
+			if(file_columns[i] >= header.column_count)
+				return fail(std::string("The operator file has a column beyond its source: ") + path);
+
+		row_count = header.row_count;
+		column_count = header.column_count;
+		row_offsets = file_row_offsets;
+		columns = file_columns;
+		coefficients = (const double*)(data + offsets[2]);
+		return true;
+	}
+
+	// Returns the number of rows, the destination vertices.
+	unsigned WeightOperator::get_row_count() const
+	{
+		return row_count;
+	}
+
+	// Returns the number of columns, the source vertices.
+	unsigned WeightOperator::get_column_count() const
+	{
+		return column_count;
+	}
+
+	// Returns the number of non-zero coefficients.
+	size_t WeightOperator::get_entry_count() const
+	{
+		return (size_t)row_offsets[row_count];
+	}
+
+	// Returns the first entry of every row, plus an end marker.
+	const unsigned long long* WeightOperator::get_row_offsets() const
+	{
+		return row_offsets;
+	}
+
+	// Returns the column index of every entry.
+	const unsigned* WeightOperator::get_columns() const
+	{
+		return columns;
+	}
+
+	// Returns the coefficient of every entry.
+	const double* WeightOperator::get_coefficients() const
+	{
+		return coefficients;
+	}
+
+	// Returns the description of the last error.
+	const std::string& WeightOperator::get_error() const
+	{
+		return error;
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,82 @@
+#ifndef __WEIGHT_OPERATOR__
+#define __WEIGHT_OPERATOR__
+
+#include <string>
+#include <vector>
+
+#include <mappedFile.h>
+
+namespace WeightTransferTool
+{
+	// the identifier at the start of an operator file
+	const char OPERATOR_FILE_MAGIC[4] = {'W', 'T', 'O', 'F'};
+	// the current operator file version
+	const unsigned OPERATOR_FILE_VERSION = 1;
+	// the alignment of every array in an operator file
+	const unsigned OPERATOR_FILE_ALIGNMENT = 64;
+	// the number of arrays in an operator file
+	const unsigned OPERATOR_SECTION_COUNT = 3;
+
+	// The header of an operator file.  It is followed by the row offsets, column
+	// indexes and coefficients of the operator, each starting on an
+	// OPERATOR_FILE_ALIGNMENT boundary in that order, stored in the byte order
+	// of the machine which wrote them.
+	struct OperatorFileHeader
+	{
+		char magic[4];							// The OPERATOR_FILE_MAGIC identifier.
+		unsigned version;						// The file format version.
+		unsigned row_count;						// The number of destination vertices.
+		unsigned column_count;					// The number of source vertices.
+		unsigned long long entry_count;			// The number of non-zero coefficients.
+		unsigned char reserved[40];				// Zero filled space for later versions.
+	};
+
+	// This class holds a transfer as a sparse matrix in compressed sparse row
+	// form.  Every row is a destination vertex and lists the source vertices
+	// it blends with their coefficients, so applying the operator to the
+	// source weights gives the transferred weights without searching the
+	// source again.  The arrays are owned when built, or mapped from a file.
+	class WeightOperator
+	{
+		public:
+			WeightOperator();						// WeightOperator class constructor.
+			~WeightOperator(){};					// WeightOperator class deconstructor.
+			void reset(unsigned);					// Clears the operator to no rows over the given number of columns.
+			void append_row(const unsigned*,		// Appends a row with the given column indexes
+							const double*,			// and coefficients.
+							unsigned);
+			void apply(const double*, unsigned,		// Multiplies source values with the given number of channels
+					   double*, unsigned) const;	// per vertex into destination values, spread over the given
+													// number of threads.
+			bool compose(const WeightOperator&,		// Replaces this operator with the first operator followed by
+						 const WeightOperator&,		// the second, spread over the given number of threads.  Returns
+						 unsigned);					// false if the first's rows are not the second's columns.
+			bool save(const char*);					// Writes the operator to a file, returns false on failure.
+			bool open(const char*);					// Maps an operator file, returns false on failure.
+
+			unsigned get_row_count() const;			// Returns the number of rows, the destination vertices.
+			unsigned get_column_count() const;		// Returns the number of columns, the source vertices.
+			size_t get_entry_count() const;			// Returns the number of non-zero coefficients.
+			const unsigned long long* get_row_offsets() const;	// Returns the first entry of every row, plus an end marker.
+			const unsigned* get_columns() const;	// Returns the column index of every entry.
+			const double* get_coefficients() const;	// Returns the coefficient of every entry.
+			const std::string& get_error() const;	// Returns the description of the last error.
+
+		private:
+			bool fail(const std::string&);			// Stores an error message, clears the operator and returns false.
+			void use_owned_arrays();				// Points the arrays at the owned arrays.
+
+			MappedFile file;						// The memory-mapped operator file.
+			std::string error;						// The description of the last error.
+			unsigned row_count;						// The number of rows.
+			unsigned column_count;					// The number of columns.
+			const unsigned long long* row_offsets;	// The first entry of every row, plus an end marker.
+			const unsigned* columns;				// The column index of every entry.
+			const double* coefficients;				// The coefficient of every entry.
+			std::vector<unsigned long long> owned_row_offsets;	// The row offsets when they are not mapped.
+			std::vector<unsigned> owned_columns;	// The column indexes when they are not mapped.
+			std::vector<double> owned_coefficients;	// The coefficients when they are not mapped.
+	};
+}
+
+#endif // end if undefined __WEIGHT_OPERATOR__
@@ -0,0 +1,177 @@
+
+#include <algorithm>
+
+#include <weightSmooth.h>
+#include <taskScheduler.h>
+
+namespace WeightTransferTool
+{
+	// Builds the neighbour lists of the given number of vertices from
+	// the vertex count and vertex indices of every polygon.
+	void VertexAdjacency::build(unsigned vertex_count, unsigned polygon_count,
+								const int* polygon_counts, const int* polygon_verts)
+	{
+		// every polygon edge adds each of its vertices to the other's list
+		offsets.assign(vertex_count + 1, 0);
+		size_t index = 0;
+		for(unsigned i = 0; i < polygon_count; i++)
+		{
+			unsigned count = polygon_counts[i];
+			for(unsigned j = 0; j < count; j++)
+			{
+				unsigned a = polygon_verts[index + j];
+				unsigned b = polygon_verts[index + (j + 1) % count];
+				if(a != b && a < vertex_count && b < vertex_count)
+				{
+					offsets[a + 1]++;
+					offsets[b + 1]++;
+				}
+			}
+			index += count;
+		}
+		for(unsigned i = 0; i < vertex_count; i++)
+			offsets[i + 1] += offsets[i];
+
+		neighbours.resize(offsets[vertex_count]);
+		std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+		index = 0;
+		for(unsigned i = 0; i < polygon_count; i++)
+		{
+			unsigned count = polygon_counts[i];
+			for(unsigned j = 0; j < count; j++)
+			{
+				unsigned a = polygon_verts[index + j];
+				unsigned b = polygon_verts[index + (j + 1) % count];
+				if(a != b && a < vertex_count && b < vertex_count)
+				{
+					neighbours[fill[a]++] = b;
+					neighbours[fill[b]++] = a;
+				}
+			}
+			index += count;
+		}
+
+		// Edges shared by two polygons appear twice, so every list is
+		// sorted and compacted in place, then the rows are packed.
+		unsigned packed = 0;
+		for(unsigned i = 0; i < vertex_count; i++)
+		{
+			std::vector<unsigned>::iterator start = neighbours.begin() + offsets[i];
+			std::vector<unsigned>::iterator end = neighbours.begin() + offsets[i + 1];
+			std::sort(start, end);
+			end = std::unique(start, end);
+			offsets[i] = packed;
+			for(std::vector<unsigned>::iterator it = start; it != end; ++it)
+				neighbours[packed++] = *it;
+		}
+		offsets[vertex_count] = packed;
+		neighbours.resize(packed);
+	}
+
+	// Returns the number of vertices.
+	unsigned VertexAdjacency::get_vertex_count() const
+	{
+		return offsets.empty() ? 0 : (unsigned)offsets.size() - 1;
+	}
+
+	// Returns the start of every vertex's neighbours, plus an end marker.
+	const unsigned* VertexAdjacency::get_offsets() const
+	{
+		return offsets.data();
+	}
+
+	// Returns the neighbour lists of every vertex.
+	const unsigned* VertexAdjacency::get_neighbours() const
+	{
+		return neighbours.data();
+	}
+
+	// Runs Jacobi iterations of Laplacian smoothing over an array of channel_count
+	// weights per vertex, spread over the given number of threads.  Every iteration
+	// blends each vertex towards the average of its neighbours' previous values.
+	void smooth_weights(const VertexAdjacency& adjacency, double* weights, unsigned channel_count,
+						unsigned iterations, double strength, unsigned thread_count)
+	{
+		unsigned vertex_count = adjacency.get_vertex_count();
+		if(iterations == 0 || vertex_count == 0)
+			return;
+
+		// Each iteration reads the previous values only, so the vertex
+		// ranges are independent and the result does not depend on the
+		// number of threads.
+		std::vector<double> buffer((size_t)vertex_count * channel_count);
+		const unsigned* offsets = adjacency.get_offsets();
+		const unsigned* neighbours = adjacency.get_neighbours();
+		double* current = weights;
+		double* next = &buffer[0];
+
+		for(unsigned iteration = 0; iteration < iterations; iteration++)
+		{
+			parallel_for(vertex_count, thread_count, [&](unsigned start, unsigned end)
+			{
+				for(unsigned i = start; i < end; i++)
+				{
+					const double* value = &current[(size_t)i * channel_count];
+					double* out_value = &next[(size_t)i * channel_count];
+					unsigned neighbour_count = offsets[i + 1] - offsets[i];
+					if(neighbour_count == 0)
+					{
+						for(unsigned c = 0; c < channel_count; c++)
+							out_value[c] = value[c];
+						continue;
+					}
+					for(unsigned c = 0; c < channel_count; c++)
+					{
+						double sum = 0.0;
+						for(unsigned n = offsets[i]; n < offsets[i + 1]; n++)
+							sum += current[(size_t)neighbours[n] * channel_count + c];
+						out_value[c] = value[c] + strength * (sum / neighbour_count - value[c]);
+					}
+				}
+			});
+			std::swap(current, next);
+		}
+		// an odd number of iterations leaves the result in the buffer
+		if(current != weights)
+			std::copy(current, current + (size_t)vertex_count * channel_count, weights);
+	}
+
+	// Scales the channels of every vertex to sum to one, vertices
+	// whose channels sum to zero are left unchanged.
+	void normalize_weights(double* weights, unsigned vertex_count, unsigned channel_count,
+						   unsigned thread_count)
+	{
+		parallel_for(vertex_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			for(unsigned i = start; i < end; i++)
+			{
+				double* value = &weights[(size_t)i * channel_count];
+				double sum = 0.0;
+				for(unsigned c = 0; c < channel_count; c++)
+					sum += value[c];
+				if(sum == 0.0)
+					continue;
+				for(unsigned c = 0; c < channel_count; c++)
+					value[c] /= sum;
+			}
+		});
+	}
+
+	// Returns true if the settings ask for any pass.
+	bool is_smoothing_enabled(const SmoothSettings& settings)
+	{
+		return settings.iterations > 0 || settings.normalize;
+	}
+
+	// Runs the smoothing and normalization the settings ask for over an array of channel_count
+	// weights for the given number of vertices.  The adjacency is only needed when smoothing.
+	void apply_smooth_settings(const SmoothSettings& settings, const VertexAdjacency& adjacency,
+							   double* weights, unsigned vertex_count, unsigned channel_count,
+							   unsigned thread_count)
+	{
+		smooth_weights(adjacency, weights, channel_count, settings.iterations, settings.strength, thread_count);
+		// a single channel has nothing to be normalized against
+		if(settings.normalize && channel_count > 1)
+			normalize_weights(weights, vertex_count, channel_count, thread_count);
+	}
+} // end namespace WeightTransferTool
@@ -0,0 +1,54 @@
+#ifndef __WEIGHT_SMOOTH__
+#define __WEIGHT_SMOOTH__
+
+#include <stddef.h>
+#include <vector>
+
+namespace WeightTransferTool
+{
+	// the default fraction of the neighbour average blended in per smoothing iteration
+	const double DEFAULT_SMOOTH_STRENGTH = 0.5;
+
+	// The settings of the optional pass run over the transferred weights.
+	struct SmoothSettings
+	{
+		unsigned iterations;					// The number of smoothing iterations, zero for none.
+		double strength;						// The fraction of the neighbour average blended in per iteration.
+		bool normalize;							// Indicates the channels of every vertex are scaled to sum to one.
+	};
+
+	// The edge-connected neighbours of every vertex of a mesh in
+	// compressed sparse row form.  The neighbours of vertex i are
+	// neighbours[offsets[i]] up to neighbours[offsets[i + 1]].
+	class VertexAdjacency
+	{
+		public:
+			VertexAdjacency(){};					// VertexAdjacency class constructor.
+			~VertexAdjacency(){};					// VertexAdjacency class deconstructor.
+			void build(unsigned, unsigned,			// Builds the neighbour lists of the given number of vertices
+					   const int*, const int*);		// from the vertex count and vertex indices of every polygon.
+			unsigned get_vertex_count() const;		// Returns the number of vertices.
+			const unsigned* get_offsets() const;	// Returns the start of every vertex's neighbours, plus an end marker.
+			const unsigned* get_neighbours() const;	// Returns the neighbour lists of every vertex.
+
+		private:
+			std::vector<unsigned> offsets;			// The start of every vertex's neighbours, plus an end marker.
+			std::vector<unsigned> neighbours;		// The sorted, unique neighbours of every vertex.
+	};
+
+	void smooth_weights(const VertexAdjacency&,	// Runs Jacobi iterations of Laplacian smoothing over an
+						double*,				// array of channel_count weights per vertex, spread over
+						unsigned,				// the given number of threads.  Every iteration blends each
+						unsigned,				// vertex towards the average of its neighbours' previous values.
+						double,
+						unsigned);
+	void normalize_weights(double*, unsigned,	// Scales the channels of every vertex to sum to one, vertices
+						   unsigned, unsigned);	// whose channels sum to zero are left unchanged.
+	bool is_smoothing_enabled(const SmoothSettings&);	// Returns true if the settings ask for any pass.
+	void apply_smooth_settings(const SmoothSettings&,	// Runs the smoothing and normalization the settings
+							   const VertexAdjacency&,	// ask for over an array of channel_count weights for
+							   double*, unsigned,		// the given number of vertices.  The adjacency is
+							   unsigned, unsigned);		// only needed when smoothing.
+}
+
+#endif // end if undefined __WEIGHT_SMOOTH__
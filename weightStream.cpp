@@ -0,0 +1,409 @@
+
+#include <algorithm>
+#include <chrono>
+
+#include <weightStream.h>
+#include <taskScheduler.h>
+#include <systemInfo.h>
+
+namespace WeightTransferTool
+{
+	// the number of bits of each axis interleaved into a spatial sort key
+	const unsigned SPATIAL_KEY_BITS = 10;
+
+	// Spreads the low SPATIAL_KEY_BITS bits of a value out to every third bit.
+	static unsigned spread_bits(unsigned value)
+	{
+		value &= 0x3FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	// Orders a chunk's positions along a Morton curve through their bounding
+	// box, so consecutive vertices of the order lie close together and every
+	// task walks a compact part of the source tree whatever the mesh's vertex order.
+	static void sort_spatially(const Point3d* positions,
+							   unsigned count,
+							   std::vector<std::pair<unsigned, unsigned> >& keys,
+							   std::vector<unsigned>& order)
+	{
+		Point3d min_point = positions[0];
+		Point3d max_point = positions[0];
+		for(unsigned i = 1; i < count; i++)
+		{
+			min_point.x = std::min(min_point.x, positions[i].x);
+			min_point.y = std::min(min_point.y, positions[i].y);
+			min_point.z = std::min(min_point.z, positions[i].z);
+			max_point.x = std::max(max_point.x, positions[i].x);
+			max_point.y = std::max(max_point.y, positions[i].y);
+			max_point.z = std::max(max_point.z, positions[i].z);
+		}
+		double extent = std::max(max_point.x - min_point.x,
+								 std::max(max_point.y - min_point.y, max_point.z - min_point.z));
+		double scale = extent > 0.0 ? ((1 << SPATIAL_KEY_BITS) - 1) / extent : 0.0;
+
+		keys.resize(count);
+		for(unsigned i = 0; i < count; i++)
+		{
+			unsigned x = (unsigned)((positions[i].x - min_point.x) * scale);
+			unsigned y = (unsigned)((positions[i].y - min_point.y) * scale);
+			unsigned z = (unsigned)((positions[i].z - min_point.z) * scale);
+			keys[i].first = spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2);
+			keys[i].second = i;
+		}
+		std::sort(keys.begin(), keys.end());
+
+		order.resize(count);
+		for(unsigned i = 0; i < count; i++)
+			order[i] = keys[i].second;
+	}
+
+	// The counts gathered by one thread while sampling a chunk.
+	struct SampleCounts
+	{
+		unsigned matched_count;					// The number of positions matched to a coincident source vertex.
+		unsigned walked_count;					// The number of closest points found by a seeded walk.
+		unsigned outside_count;					// The number of positions beyond the maximum distance.
+	};
+
+	// Returns true if the settings limit the sample distance.
+	bool is_distance_limited(const DistanceSettings& settings)
+	{
+		return settings.max_distance >= 0.0;
+	}
+
+	// Returns true if a transfer with the settings is a linear map of the source
+	// weights, so every destination weight is a fixed blend of source weights.
+	// A non-zero default value or existing weights out of range add other terms.
+	bool is_linear_transfer(InterpolationMode interpolation, const DistanceSettings& settings)
+	{
+		return is_linear_interpolation(interpolation) &&
+			   (!is_distance_limited(settings) || (!settings.keep_existing && settings.default_value == 0.0));
+	}
+
+	// Blends the sampled weights of a position toward its fallback weights by how far
+	// into the falloff band its distance lies.  Positions beyond the maximum distance
+	// take the fallback weights, which are the existing weights when the destination
+	// has them, or else the default value.  Returns true if the position is out of range.
+	static bool apply_falloff(const DistanceSettings& settings,
+							  double distance,
+							  const double* existing_weights,
+							  double* vertex_weights)
+	{
+		double band_start = std::max(0.0, settings.max_distance - settings.falloff);
+		if(distance <= band_start)
+			return false;
+
+		bool outside = distance > settings.max_distance;
+		double blend = outside ? 1.0 : (distance - band_start) / (settings.max_distance - band_start);
+		for(unsigned c = 0; c < WEIGHT_COUNT; c++)
+		{
+			double fallback = existing_weights != NULL ? existing_weights[c] : settings.default_value;
+			vertex_weights[c] += (fallback - vertex_weights[c]) * blend;
+		}
+		return outside;
+	}
+
+	// Samples the positions of a chunk listed in part of an order, adding the number
+	// of positions matched to a coincident source vertex, the number found by a seeded
+	// walk and the number out of range to the counts.  In coherent mode every search is
+	// seeded with the closest triangle of the previous position, which the order keeps
+	// nearby.  With a maximum distance the searches are pruned to it and the weights
+	// of distant positions fall back as the settings ask.
+	template<class Interpolation>
+	static void sample_range(const WeightedSurface& source,
+							 const Point3d* positions,
+							 const double* existing_weights,
+							 double* weights,
+							 const unsigned* order,
+							 unsigned start,
+							 unsigned end,
+							 bool coherent,
+							 const DistanceSettings& distance_settings,
+							 SampleCounts& counts)
+	{
+		bool limited = is_distance_limited(distance_settings);
+		double max_distance = limited ? distance_settings.max_distance : -1.0;
+		SearchSeed seed;
+		seed.triangle = NO_TRIANGLE;
+		for(unsigned i = start; i < end; i++)
+		{
+			unsigned index = order[i];
+			double* vertex_weights = &weights[index * WEIGHT_COUNT];
+			double distance = 0.0;
+			// Vertices that sit on a source vertex take its weights
+			// directly, only the rest are projected onto the source surface.
+			if(source.sample_vertex(positions[index], vertex_weights))
+				counts.matched_count++;
+			else if(!coherent)
+				source.sample_surface<Interpolation>(positions[index], max_distance, vertex_weights, distance);
+			else if(source.sample_surface_from<Interpolation>(positions[index], max_distance, seed,
+															  vertex_weights, distance))
+				counts.walked_count++;
+
+			if(limited &&
+			   apply_falloff(distance_settings, distance,
+							 existing_weights != NULL ? &existing_weights[index * WEIGHT_COUNT] : NULL,
+							 vertex_weights))
+				counts.outside_count++;
+		}
+	}
+
+	// Samples part of an order with the sample loop of an interpolation mode.
+	// The mode is dispatched once per task, never per position.
+	static void sample_range(InterpolationMode interpolation,
+							 const WeightedSurface& source,
+							 const Point3d* positions,
+							 const double* existing_weights,
+							 double* weights,
+							 const unsigned* order,
+							 unsigned start,
+							 unsigned end,
+							 bool coherent,
+							 const DistanceSettings& distance_settings,
+							 SampleCounts& counts)
+	{
+		switch(interpolation)
+		{
+			case NEAREST_INTERPOLATION:
+				sample_range<NearestInterpolation>(source, positions, existing_weights, weights, order, start, end,
+												   coherent, distance_settings, counts);
+				break;
+			case MAX_INTERPOLATION:
+				sample_range<MaxInterpolation>(source, positions, existing_weights, weights, order, start, end,
+											   coherent, distance_settings, counts);
+				break;
+			case SMOOTH_INTERPOLATION:
+				sample_range<SmoothInterpolation>(source, positions, existing_weights, weights, order, start, end,
+												  coherent, distance_settings, counts);
+				break;
+			default:
+				sample_range<LinearInterpolation>(source, positions, existing_weights, weights, order, start, end,
+												  coherent, distance_settings, counts);
+				break;
+		}
+	}
+
+	// Scales the coefficients of a stencil toward zero by how far into the falloff band
+	// its distance lies, as apply_falloff blends weights toward a zero default value.
+	// Positions beyond the maximum distance are left with an empty stencil.  Returns
+	// true if the position is out of range.
+	static bool apply_stencil_falloff(const DistanceSettings& settings, double distance, SampleStencil& stencil)
+	{
+		double band_start = std::max(0.0, settings.max_distance - settings.falloff);
+		if(distance <= band_start)
+			return false;
+		if(distance > settings.max_distance)
+		{
+			stencil.count = 0;
+			return true;
+		}
+
+		double blend = (distance - band_start) / (settings.max_distance - band_start);
+		for(unsigned i = 0; i < stencil.count; i++)
+			stencil.coefficients[i] -= stencil.coefficients[i] * blend;
+		return false;
+	}
+
+	// Finds the stencils of the positions of a chunk listed in part of an order, like
+	// sample_range finds their weights, adding to the same counts.
+	template<class Interpolation>
+	static void sample_stencil_range(const WeightedSurface& source,
+									 const Point3d* positions,
+									 SampleStencil* stencils,
+									 const unsigned* order,
+									 unsigned start,
+									 unsigned end,
+									 bool coherent,
+									 const DistanceSettings& distance_settings,
+									 SampleCounts& counts)
+	{
+		bool limited = is_distance_limited(distance_settings);
+		double max_distance = limited ? distance_settings.max_distance : -1.0;
+		SearchSeed seed;
+		seed.triangle = NO_TRIANGLE;
+		for(unsigned i = start; i < end; i++)
+		{
+			unsigned index = order[i];
+			SampleStencil& stencil = stencils[index];
+			double distance = 0.0;
+			if(source.get_vertex_stencil(positions[index], stencil))
+				counts.matched_count++;
+			else if(!coherent)
+				source.get_surface_stencil<Interpolation>(positions[index], max_distance, stencil, distance);
+			else if(source.get_surface_stencil_from<Interpolation>(positions[index], max_distance, seed,
+																   stencil, distance))
+				counts.walked_count++;
+
+			if(limited && apply_stencil_falloff(distance_settings, distance, stencil))
+				counts.outside_count++;
+		}
+	}
+
+	// Finds the stencils of part of an order with the loop of a linear interpolation mode.
+	static void sample_stencil_range(InterpolationMode interpolation,
+									 const WeightedSurface& source,
+									 const Point3d* positions,
+									 SampleStencil* stencils,
+									 const unsigned* order,
+									 unsigned start,
+									 unsigned end,
+									 bool coherent,
+									 const DistanceSettings& distance_settings,
+									 SampleCounts& counts)
+	{
+		switch(interpolation)
+		{
+			case NEAREST_INTERPOLATION:
+				sample_stencil_range<NearestInterpolation>(source, positions, stencils, order, start, end,
+														   coherent, distance_settings, counts);
+				break;
+			case SMOOTH_INTERPOLATION:
+				sample_stencil_range<SmoothInterpolation>(source, positions, stencils, order, start, end,
+														  coherent, distance_settings, counts);
+				break;
+			default:
+				sample_stencil_range<LinearInterpolation>(source, positions, stencils, order, start, end,
+														  coherent, distance_settings, counts);
+				break;
+		}
+	}
+
+	// Runs a transfer over every position of a destination stream in chunks of
+	// the given size, spread over the given number of threads.  Each chunk is
+	// sorted along a space-filling curve and split into small spatially coherent
+	// tasks which are balanced by work stealing, as the cost of a query varies a
+	// lot with the distance to the source.  The transfer is given every chunk
+	// before it is sampled, samples the ranges of its order, adding to the counts
+	// of the thread running it, and takes the chunk's results once it is sampled.
+	// The counts, times and thread statistics of every chunk are added to the stats.
+	template<class BeginChunk, class SampleChunkRange, class EndChunk>
+	static TransferStats stream_chunks(const WeightedSurface& source,
+									   DestinationStream& dest,
+									   unsigned chunk_size,
+									   unsigned thread_count,
+									   BeginChunk begin_chunk,
+									   SampleChunkRange sample_chunk_range,
+									   EndChunk end_chunk)
+	{
+		TransferStats stats = TransferStats();
+		if(thread_count == 0)
+			thread_count = 1;
+
+		// Only one chunk of positions is held at a time
+		// so the working memory does not grow with the destination.
+		std::vector<Point3d> positions(chunk_size);
+		std::vector<std::pair<unsigned, unsigned> > keys;
+		std::vector<unsigned> order;
+		std::vector<SampleCounts> counts(thread_count);
+		TaskScheduler scheduler(thread_count);
+		unsigned count;
+
+		while((count = dest.read_positions(&positions[0], chunk_size)) > 0)
+		{
+			begin_chunk(count);
+			sort_spatially(&positions[0], count, keys, order);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			unsigned task_count = (count + TRANSFER_TASK_SIZE - 1) / TRANSFER_TASK_SIZE;
+			SampleCounts empty_counts = {0, 0, 0};
+			std::fill(counts.begin(), counts.end(), empty_counts);
+			scheduler.run(task_count, [&](unsigned task, unsigned thread)
+			{
+				unsigned task_start = task * TRANSFER_TASK_SIZE;
+				unsigned task_end = std::min(count, task_start + TRANSFER_TASK_SIZE);
+				sample_chunk_range(&positions[0], &order[0], task_start, task_end, counts[thread]);
+			});
+			stats.sample_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			for(unsigned t = 0; t < thread_count; t++)
+			{
+				stats.matched_count += counts[t].matched_count;
+				stats.walked_count += counts[t].walked_count;
+				stats.outside_count += counts[t].outside_count;
+			}
+
+			end_chunk(count);
+			stats.vertex_count += count;
+			stats.chunk_count++;
+		}
+
+		stats.face_count = source.get_polygon_count();
+		stats.built_face_count = source.get_built_face_count();
+		stats.thread_stats = scheduler.get_thread_stats();
+		stats.peak_resident_size = get_peak_resident_size();
+		return stats;
+	}
+
+	// Samples every position of a destination stream in chunks of the given size,
+	// spread over the given number of threads, and writes the weights of every
+	// chunk back to it.  When vertices out of range keep their existing weights
+	// those of every chunk are read from the destination, which falls back to
+	// the default value if it has none.
+	TransferStats stream_weights(const WeightedSurface& source,
+								 DestinationStream& dest,
+								 unsigned chunk_size,
+								 unsigned thread_count,
+								 bool coherent,
+								 InterpolationMode interpolation,
+								 const DistanceSettings& distance_settings)
+	{
+		std::vector<double> weights((size_t)chunk_size * WEIGHT_COUNT);
+		std::vector<double> existing_weights;
+		if(is_distance_limited(distance_settings) && distance_settings.keep_existing)
+			existing_weights.resize((size_t)chunk_size * WEIGHT_COUNT);
+		const double* chunk_existing_weights = NULL;
+
+		return stream_chunks(source, dest, chunk_size, thread_count,
+			[&](unsigned count)
+			{
+				chunk_existing_weights = NULL;
+				if(!existing_weights.empty() && dest.read_existing_weights(&existing_weights[0], count))
+					chunk_existing_weights = &existing_weights[0];
+			},
+			[&](const Point3d* positions, const unsigned* order, unsigned start, unsigned end, SampleCounts& counts)
+			{
+				sample_range(interpolation, source, positions, chunk_existing_weights, &weights[0], order,
+							 start, end, coherent, distance_settings, counts);
+			},
+			[&](unsigned count)
+			{
+				dest.write_weights(&weights[0], count);
+			});
+	}
+
+	// Builds the operator which maps the source weights to the weights stream_weights
+	// would sample for every position of a destination stream.  The positions are
+	// searched in the same chunks and tasks, but every task records the source
+	// vertices and coefficients its positions blend instead of their weights.  The
+	// rows of a chunk are appended in destination order once it is sampled.
+	TransferStats stream_operator(const WeightedSurface& source,
+								  DestinationStream& dest,
+								  unsigned chunk_size,
+								  unsigned thread_count,
+								  bool coherent,
+								  InterpolationMode interpolation,
+								  const DistanceSettings& distance_settings,
+								  WeightOperator& transfer_operator)
+	{
+		transfer_operator.reset(source.get_vertex_count());
+		std::vector<SampleStencil> stencils(chunk_size);
+
+		return stream_chunks(source, dest, chunk_size, thread_count,
+			[](unsigned)
+			{
+			},
+			[&](const Point3d* positions, const unsigned* order, unsigned start, unsigned end, SampleCounts& counts)
+			{
+				sample_stencil_range(interpolation, source, positions, &stencils[0], order,
+									 start, end, coherent, distance_settings, counts);
+			},
+			[&](unsigned count)
+			{
+				for(unsigned i = 0; i < count; i++)
+					transfer_operator.append_row(stencils[i].vertices, stencils[i].coefficients, stencils[i].count);
+			});
+	}
+} // end namespace WeightTransferTool
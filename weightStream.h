@@ -0,0 +1,81 @@
+#ifndef __WEIGHT_STREAM__
+#define __WEIGHT_STREAM__
+
+#include <vector>
+
+#include <weightedSurface.h>
+#include <weightOperator.h>
+#include <taskScheduler.h>
+
+namespace WeightTransferTool
+{
+	// the default number of destination vertices processed per chunk
+	const unsigned DEFAULT_CHUNK_SIZE = 65536;
+	// the number of destination vertices sampled per scheduler task
+	const unsigned TRANSFER_TASK_SIZE = 256;
+
+	// The settings which limit how far from the source destination vertices are sampled.
+	struct DistanceSettings
+	{
+		double max_distance;					// The largest distance a vertex is sampled from, negative for no limit.
+		double falloff;							// The width of the band inside the maximum distance over which the
+												// sampled weights blend toward the fallback weights.
+		bool keep_existing;						// Indicates vertices out of range fall back to their existing
+												// weights rather than the default value.
+		double default_value;					// The fallback value of every channel.
+	};
+
+	// Statistics gathered while transferring weights.
+	struct TransferStats
+	{
+		unsigned vertex_count;							// The number of destination vertices transferred.
+		unsigned matched_count;							// The number of vertices matched to a coincident source vertex.
+		unsigned walked_count;							// The number of closest points found by a seeded walk.
+		unsigned outside_count;							// The number of vertices beyond the maximum distance.
+		unsigned chunk_count;							// The number of chunks the transfer was split into.
+		unsigned face_count;							// The number of source faces.
+		unsigned built_face_count;						// The number of source faces whose data has been built.
+		size_t peak_resident_size;						// The peak resident set size of the process in bytes.
+		double sample_seconds;							// The wall time spent sampling chunks.
+		std::vector<ThreadStats> thread_stats;			// The load balance statistics of every thread.
+	};
+
+	// This interface reads destination positions and writes
+	// destination weights a fixed-size chunk at a time.
+	class DestinationStream
+	{
+		public:
+			virtual ~DestinationStream(){};
+			virtual unsigned read_positions(Point3d*, unsigned) = 0;	// Reads up to the given number of world space
+																		// positions and returns the number read.
+			virtual void write_weights(const double*, unsigned) = 0;	// Writes the weights of the positions last read.
+			virtual bool read_existing_weights(double*, unsigned)		// Reads the current weights of the positions
+			{															// last read, returns false if there are none.
+				return false;
+			}
+	};
+
+	bool is_distance_limited(const DistanceSettings&);	// Returns true if the settings limit the sample distance.
+	bool is_linear_transfer(InterpolationMode,			// Returns true if a transfer with the settings is a linear
+							const DistanceSettings&);	// map of the source weights, which an operator can hold.
+
+	TransferStats stream_weights(const WeightedSurface&,	// Samples every position of a destination stream
+								 DestinationStream&,		// in chunks of the given size, spread over the
+								 unsigned,					// given number of threads.  Coherent mode seeds
+								 unsigned,					// each closest point search with the result of the
+								 bool,						// previous nearby position, which can end at another
+															// surface point than the exact search.  The corner weights
+								 InterpolationMode,			// are blended as the interpolation mode asks, and
+								 const DistanceSettings&);	// vertices far from the source fall back as the
+															// distance settings ask.
+	TransferStats stream_operator(const WeightedSurface&,	// Builds the operator which maps the source weights to
+								  DestinationStream&,		// the weights stream_weights would sample for every
+								  unsigned,					// position of a destination stream, with the same
+								  unsigned,					// chunks, threads, search and settings, which must
+								  bool,						// make a linear transfer.  No weights are written
+								  InterpolationMode,		// to the stream.
+								  const DistanceSettings&,
+								  WeightOperator&);
+}
+
+#endif // end if undefined __WEIGHT_STREAM__
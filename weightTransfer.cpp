@@ -40,52 +40,364 @@ namespace WeightTransferTool
 		return new WeightTransfer();
 	}
 
+	// WeightTransfer syntax function required by Maya plug-in.
+	MSyntax WeightTransfer::new_syntax()
+	{
+		MSyntax syntax;
+		// The source and destination weight attribute names, or a single
+		// attribute name when a weight file is exported, imported or
+		// used as the source weights.
+		syntax.setObjectType(MSyntax::kStringObjects, 1, 2);
+		syntax.addFlag(CHUNK_SIZE_FLAG, CHUNK_SIZE_FLAG_LONG, MSyntax::kUnsigned);
+		syntax.addFlag(THREAD_COUNT_FLAG, THREAD_COUNT_FLAG_LONG, MSyntax::kUnsigned);
+		syntax.addFlag(EXPORT_WEIGHTS_FLAG, EXPORT_WEIGHTS_FLAG_LONG, MSyntax::kString);
+		syntax.addFlag(IMPORT_WEIGHTS_FLAG, IMPORT_WEIGHTS_FLAG_LONG, MSyntax::kString);
+		syntax.addFlag(SOURCE_WEIGHTS_FLAG, SOURCE_WEIGHTS_FLAG_LONG, MSyntax::kString);
+		syntax.addFlag(SMOOTH_ITERATIONS_FLAG, SMOOTH_ITERATIONS_FLAG_LONG, MSyntax::kUnsigned);
+		syntax.addFlag(SMOOTH_STRENGTH_FLAG, SMOOTH_STRENGTH_FLAG_LONG, MSyntax::kDouble);
+		syntax.addFlag(NORMALIZE_FLAG, NORMALIZE_FLAG_LONG);
+		syntax.addFlag(COHERENT_SEARCH_FLAG, COHERENT_SEARCH_FLAG_LONG);
+		syntax.addFlag(QUANTIZE_SOURCE_FLAG, QUANTIZE_SOURCE_FLAG_LONG);
+		syntax.addFlag(MIRROR_FLAG, MIRROR_FLAG_LONG, MSyntax::kString);
+		syntax.addFlag(MIRROR_INVERSE_FLAG, MIRROR_INVERSE_FLAG_LONG);
+		syntax.addFlag(INTERPOLATION_FLAG, INTERPOLATION_FLAG_LONG, MSyntax::kString);
+		syntax.addFlag(MAX_DISTANCE_FLAG, MAX_DISTANCE_FLAG_LONG, MSyntax::kDouble);
+		syntax.addFlag(FALLOFF_FLAG, FALLOFF_FLAG_LONG, MSyntax::kDouble);
+		syntax.addFlag(DEFAULT_VALUE_FLAG, DEFAULT_VALUE_FLAG_LONG, MSyntax::kDouble);
+		syntax.addFlag(KEEP_EXISTING_FLAG, KEEP_EXISTING_FLAG_LONG);
+		return syntax;
+	}
+
 	// Main entry function to execute weight transfer command.
 	MStatus WeightTransfer::doIt( const MArgList& args )
 	{
 		MStatus stat;
-		if(args.length() < 2)
+		MArgDatabase arg_data(syntax(), args, &stat);
+		MStringArray attr_names;
+		if(stat)
+			stat = arg_data.getObjects(attr_names);
+		if(!stat)
 		{
 			display_error("The weightTransfer command requires two arguments, a source and destination attribute.");
 			return MS::kFailure;
 		}
 
-		MString source_attr_name;
-		MString dest_attr_name;
-		args.get(0, source_attr_name);
-		args.get(1, dest_attr_name);
+		// a weight file is exported from or imported to the first selected mesh
+		if(arg_data.isFlagSet(EXPORT_WEIGHTS_FLAG) || arg_data.isFlagSet(IMPORT_WEIGHTS_FLAG))
+			return transfer_weight_file(arg_data, attr_names);
+
+		bool use_weight_file = arg_data.isFlagSet(SOURCE_WEIGHTS_FLAG);
+		bool mirror = arg_data.isFlagSet(MIRROR_FLAG);
+		if(attr_names.length() != (use_weight_file || mirror ? 1u : 2u))
+		{
+			if(mirror)
+			{
+				display_error("Mirroring weights requires one weight attribute.");
+			}
+			else if(use_weight_file)
+			{
+				display_error("The weightTransfer command requires one destination attribute with a source weight file.");
+			}
+			else
+			{
+				display_error("The weightTransfer command requires two arguments, a source and destination attribute.");
+			}
+			return MS::kFailure;
+		}
+		MString dest_attr_name = attr_names[attr_names.length() - 1];
+
+		unsigned chunk_size = DEFAULT_CHUNK_SIZE;
+		if(arg_data.isFlagSet(CHUNK_SIZE_FLAG))
+			arg_data.getFlagArgument(CHUNK_SIZE_FLAG, 0, chunk_size);
+		if(chunk_size == 0)
+		{
+			display_error("The chunk size must be greater than zero.");
+			return MS::kFailure;
+		}
+
+		unsigned thread_count = get_processor_count();
+		if(arg_data.isFlagSet(THREAD_COUNT_FLAG))
+			arg_data.getFlagArgument(THREAD_COUNT_FLAG, 0, thread_count);
+		if(thread_count == 0)
+		{
+			display_error("The thread count must be greater than zero.");
+			return MS::kFailure;
+		}
+
+		SmoothSettings smooth_settings = {0, DEFAULT_SMOOTH_STRENGTH, false};
+		if(arg_data.isFlagSet(SMOOTH_ITERATIONS_FLAG))
+			arg_data.getFlagArgument(SMOOTH_ITERATIONS_FLAG, 0, smooth_settings.iterations);
+		if(arg_data.isFlagSet(SMOOTH_STRENGTH_FLAG))
+			arg_data.getFlagArgument(SMOOTH_STRENGTH_FLAG, 0, smooth_settings.strength);
+		if(smooth_settings.strength < 0.0 || smooth_settings.strength > 1.0)
+		{
+			display_error("The smooth strength must be between zero and one.");
+			return MS::kFailure;
+		}
+		smooth_settings.normalize = arg_data.isFlagSet(NORMALIZE_FLAG);
+		bool coherent = arg_data.isFlagSet(COHERENT_SEARCH_FLAG);
+		InterpolationMode interpolation = LINEAR_INTERPOLATION;
+		if(arg_data.isFlagSet(INTERPOLATION_FLAG))
+		{
+			MString interpolation_name;
+			arg_data.getFlagArgument(INTERPOLATION_FLAG, 0, interpolation_name);
+			if(!parse_interpolation_mode(interpolation_name.asChar(), interpolation))
+			{
+				display_error("The interpolation must be linear, nearest, max or smooth.");
+				return MS::kFailure;
+			}
+		}
+
+		// vertices further from the source than the maximum distance fall back
+		// to the default value or their existing weights
+		DistanceSettings distance_settings = {-1.0, 0.0, false, 0.0};
+		if(arg_data.isFlagSet(MAX_DISTANCE_FLAG))
+		{
+			arg_data.getFlagArgument(MAX_DISTANCE_FLAG, 0, distance_settings.max_distance);
+			if(distance_settings.max_distance < 0.0)
+			{
+				display_error("The maximum distance must not be negative.");
+				return MS::kFailure;
+			}
+		}
+		else if(arg_data.isFlagSet(FALLOFF_FLAG) || arg_data.isFlagSet(DEFAULT_VALUE_FLAG) ||
+				arg_data.isFlagSet(KEEP_EXISTING_FLAG))
+		{
+			display_error("The falloff, default value and keep existing flags require a maximum distance.");
+			return MS::kFailure;
+		}
+		if(arg_data.isFlagSet(FALLOFF_FLAG))
+			arg_data.getFlagArgument(FALLOFF_FLAG, 0, distance_settings.falloff);
+		if(distance_settings.falloff < 0.0)
+		{
+			display_error("The falloff must not be negative.");
+			return MS::kFailure;
+		}
+		if(arg_data.isFlagSet(DEFAULT_VALUE_FLAG))
+			arg_data.getFlagArgument(DEFAULT_VALUE_FLAG, 0, distance_settings.default_value);
+		distance_settings.keep_existing = arg_data.isFlagSet(KEEP_EXISTING_FLAG);
+
+		// the weights of one side of the selected mesh are mirrored onto its other side
+		if(mirror)
+		{
+			if(use_weight_file || is_smoothing_enabled(smooth_settings))
+			{
+				display_error("Mirroring weights cannot be combined with a source weight file or smoothing.");
+				return MS::kFailure;
+			}
+			return mirror_weights(arg_data, attr_names, chunk_size, thread_count, coherent, interpolation,
+								  distance_settings);
+		}
 
 		MSelectionList selected;
 		stat = MGlobal::getActiveSelectionList(selected);
 		MCHECK_ERROR(stat);
 		MItSelectionList iter( selected );
 
-		// first selection is the source mesh
-		MDagPath source_dag = get_shape_node(iter);
-		if(!source_dag.isValid())
+		// every selection but the last is a source mesh, the last is the destination mesh
+		std::vector<MDagPath> mesh_dags;
+		for( ; !iter.isDone(); iter.next())
+		{
+			MDagPath mesh_dag = get_shape_node(iter);
+			if(!mesh_dag.isValid())
+				return MS::kFailure;
+			mesh_dags.push_back(mesh_dag);
+		}
+		if(mesh_dags.size() < 2)
+		{
+			display_error("Select one or more source meshes and then the destination mesh.");
 			return MS::kFailure;
-		WeightsSource source(source_dag, source_attr_name);
-		if(!source.is_valid)
+		}
+		MDagPath dest_dag = mesh_dags.back();
+		mesh_dags.pop_back();
+		if(use_weight_file && mesh_dags.size() > 1)
+		{
+			display_error("A source weight file holds the weights of a single source mesh.");
 			return MS::kFailure;
+		}
 
-		// second selection is the destination mesh
-		iter.next();
-		MDagPath dest_dag = get_shape_node(iter);
-		if(!dest_dag.isValid())
+		// the source weights are sampled directly from the mapped weight file
+		WeightFile source_weight_file;
+		if(use_weight_file)
+		{
+			MString weight_path;
+			arg_data.getFlagArgument(SOURCE_WEIGHTS_FLAG, 0, weight_path);
+			if(!source_weight_file.open(weight_path.asChar(), true))
+			{
+				display_error(source_weight_file.get_error().c_str());
+				return MS::kFailure;
+			}
+		}
+		std::unique_ptr<WeightsSource> source(use_weight_file ?
+											  new WeightsSource(mesh_dags[0], source_weight_file, thread_count) :
+											  new WeightsSource(mesh_dags[0], attr_names[0], thread_count));
+		if(!source->is_valid)
 			return MS::kFailure;
+		// The other source meshes are appended to the first, so every destination
+		// vertex finds the closest of all the source surfaces with one search.
+		for(unsigned i = 1; i < mesh_dags.size(); i++)
+		{
+			WeightsSource piece(mesh_dags[i], attr_names[0], thread_count);
+			if(!piece.is_valid)
+				return MS::kFailure;
+			if(!source->append_source(piece))
+			{
+				display_error(MString("The source weight attribute has a different type on: ") +
+							  mesh_dags[i].fullPathName());
+				return MS::kFailure;
+			}
+		}
+		source->build_search();
+		if(arg_data.isFlagSet(QUANTIZE_SOURCE_FLAG))
+		{
+			char buffer[MAX_STRING_SIZE];
+			sprintf_s(buffer, MAX_STRING_SIZE, "Source weights quantized to 16 bits, largest error: %g",
+					  source->quantize_weights());
+			display_msg(buffer);
+		}
 
 		WeightsDestination dest(dest_dag, dest_attr_name);
 		if(!dest.is_valid)
 			return MS::kFailure;
 
-		stat = dest.transfer_weights(source);
-		if(stat)
-			display_msg("Weights transferred succesfully!");
+		TransferStats stats;
+		stat = dest.transfer_weights(*source, chunk_size, thread_count, coherent, interpolation,
+									 distance_settings, smooth_settings, stats);
+		if(!stat)
+			return stat;
+
+		display_transfer_stats(stats, coherent, distance_settings);
+		display_msg("Weights transferred succesfully!");
+
+		// the command result is the peak resident set in megabytes
+		setResult(stats.peak_resident_size / (1024.0 * 1024.0));
+		return stat;
+	}
+
+	// Reports the search, memory and thread statistics of a transfer.
+	void WeightTransfer::display_transfer_stats(const TransferStats& stats,
+												bool coherent,
+												const DistanceSettings& distance_settings)
+	{
+		char buffer[MAX_STRING_SIZE];
+		sprintf_s(buffer, MAX_STRING_SIZE, "Vertices matched to a coincident source vertex: %u of %u",
+				  stats.matched_count, stats.vertex_count);
+		display_msg(buffer);
+		if(coherent)
+		{
+			sprintf_s(buffer, MAX_STRING_SIZE, "Closest points found by the seeded walk: %u of %u",
+					  stats.walked_count, stats.vertex_count - stats.matched_count);
+			display_msg(buffer);
+		}
+		if(is_distance_limited(distance_settings))
+		{
+			sprintf_s(buffer, MAX_STRING_SIZE, "Vertices beyond the maximum distance: %u of %u",
+					  stats.outside_count, stats.vertex_count);
+			display_msg(buffer);
+		}
+		sprintf_s(buffer, MAX_STRING_SIZE, "Source faces built on demand: %u of %u",
+				  stats.built_face_count, stats.face_count);
+		display_msg(buffer);
+		sprintf_s(buffer, MAX_STRING_SIZE, "Transferred in %u chunks, peak resident set: %.1f MB",
+				  stats.chunk_count, stats.peak_resident_size / (1024.0 * 1024.0));
+		display_msg(buffer);
+		for(unsigned t = 0; t < stats.thread_stats.size(); t++)
+		{
+			const ThreadStats& thread = stats.thread_stats[t];
+			double busy_percent = stats.sample_seconds > 0.0 ? 100.0 * thread.busy_seconds / stats.sample_seconds : 0.0;
+			sprintf_s(buffer, MAX_STRING_SIZE, "Thread %u: busy %.3f s (%.0f%%), %u tasks, %u stolen",
+					  t, thread.busy_seconds, busy_percent, thread.task_count, thread.steal_count);
+			display_msg(buffer);
+		}
+	}
+
+	// Mirrors the weight attribute of the first selected mesh across the plane
+	// given by the mirror flags.  The mesh is built as a source once and only
+	// the vertices on the target side of the plane are sampled and written.
+	MStatus WeightTransfer::mirror_weights(const MArgDatabase& arg_data, const MStringArray& attr_names,
+										   unsigned chunk_size, unsigned thread_count, bool coherent,
+										   InterpolationMode interpolation,
+										   const DistanceSettings& distance_settings)
+	{
+		MString plane_name;
+		arg_data.getFlagArgument(MIRROR_FLAG, 0, plane_name);
+		MirrorPlane plane;
+		if(!parse_mirror_plane(plane_name.asChar(), arg_data.isFlagSet(MIRROR_INVERSE_FLAG), plane))
+		{
+			display_error("The mirror plane must be yz, xz or xy.");
+			return MS::kFailure;
+		}
+
+		MSelectionList selected;
+		MStatus stat = MGlobal::getActiveSelectionList(selected);
+		MCHECK_ERROR(stat);
+		MItSelectionList iter( selected );
+		MDagPath mesh_dag = get_shape_node(iter);
+		if(!mesh_dag.isValid())
+			return MS::kFailure;
+
+		WeightsSource mesh(mesh_dag, attr_names[0], thread_count);
+		if(!mesh.is_valid)
+			return MS::kFailure;
+		mesh.build_search();
+		if(arg_data.isFlagSet(QUANTIZE_SOURCE_FLAG))
+		{
+			char buffer[MAX_STRING_SIZE];
+			sprintf_s(buffer, MAX_STRING_SIZE, "Source weights quantized to 16 bits, largest error: %g",
+					  mesh.quantize_weights());
+			display_msg(buffer);
+		}
+
+		TransferStats stats;
+		stat = mesh.mirror_weights(plane, chunk_size, thread_count, coherent, interpolation, distance_settings, stats);
+		if(!stat)
+			return stat;
+
+		display_transfer_stats(stats, coherent, distance_settings);
+		display_msg("Weights mirrored succesfully!");
+		setResult(stats.peak_resident_size / (1024.0 * 1024.0));
+		return stat;
+	}
+
+	// Exports the weight attribute of the first selected mesh to a
+	// weight file, or imports a weight file into the attribute.
+	MStatus WeightTransfer::transfer_weight_file(const MArgDatabase& arg_data, const MStringArray& attr_names)
+	{
+		if(attr_names.length() != 1)
+		{
+			display_error("Exporting or importing weights requires one weight attribute.");
+			return MS::kFailure;
+		}
+		bool exporting = arg_data.isFlagSet(EXPORT_WEIGHTS_FLAG);
+		MString weight_path;
+		arg_data.getFlagArgument(exporting ? EXPORT_WEIGHTS_FLAG : IMPORT_WEIGHTS_FLAG, 0, weight_path);
+
+		MSelectionList selected;
+		MStatus stat = MGlobal::getActiveSelectionList(selected);
+		MCHECK_ERROR(stat);
+		MItSelectionList iter( selected );
+		MDagPath mesh_dag = get_shape_node(iter);
+		if(!mesh_dag.isValid())
+			return MS::kFailure;
+
+		WeightedMesh mesh;
+		stat = mesh.set_mesh(mesh_dag);
+		if(!stat)
+			return stat;
+		stat = mesh.set_weight_attribute(attr_names[0]);
+		if(!stat)
+			return stat;
+
+		stat = exporting ? mesh.export_weights(weight_path) : mesh.import_weights(weight_path);
+		if(!stat)
+			return stat;
+		display_msg(MString(exporting ? "Weights exported to " : "Weights imported from ") + weight_path);
 		return stat;
 	}
 
 	// WeightsSource class constructor.
-	WeightsSource::WeightsSource(MDagPath& mesh_dag, MString weight_attr_name)
+	WeightsSource::WeightsSource(MDagPath& mesh_dag, MString weight_attr_name, unsigned new_thread_count)
+		: thread_count(new_thread_count)
 	{
 		MStatus mesh_status = set_mesh(mesh_dag);
 		MStatus attr_status = set_weight_attribute(weight_attr_name);
@@ -119,76 +431,140 @@ namespace WeightTransferTool
 		}
 		is_valid = true;
 
-		MStatus stat;
-		MObject mesh_obj = mesh_dag.node();
+		surface.set_vertex_count(vertex_count, get_channel_count());
+		build_surface(mesh_dag, true);
+	}
 
-		// Construct Maya's mesh intersector which finds the closest
-		// point on source mesh to a sample position.
-		xform_matrix = mesh_dag.inclusiveMatrix();
-		stat = intersector.create(mesh_obj, xform_matrix);
-		MCHECK_ERROR(stat);
-		
-		unsigned poly_count = fn_mesh.numPolygons();
+	// WeightsSource class constructor for weights sampled directly from a mapped weight file.
+	WeightsSource::WeightsSource(MDagPath& mesh_dag, const WeightFile& weight_file, unsigned new_thread_count)
+		: thread_count(new_thread_count)
+	{
+		MStatus mesh_status = set_mesh(mesh_dag);
+		if(!mesh_status)
+		{
+			display_error("The source mesh was invalid.");
+			return;
+		}
+		if(vertex_count == 0)
+		{
+			display_error("The source mesh has zero vertices!");
+			return;
+		}
+		if(vertex_count != weight_file.get_vertex_count())
+		{
+			char buffer[MAX_STRING_SIZE];
+			sprintf_s(buffer, MAX_STRING_SIZE, "The source mesh's vertex count %d does not match the weight file's %u.",
+					  vertex_count, weight_file.get_vertex_count());
+			display_error(buffer);
+			return;
+		}
+		is_valid = true;
 
-		weighted_polys = new WeightedPolygon[poly_count];
-		weighted_verts = new WeightedVertex[vertex_count];
+		surface.set_vertex_count(vertex_count, weight_file.get_channel_count());
+		surface.set_weight_buffer(weight_file.get_weights(), weight_file.get_channel_count());
+		build_surface(mesh_dag, false);
+	}
 
-		MItMeshVertex vtx_iter(mesh_dag, MObject::kNullObj, &stat);
+	// Reads the vertex positions, and optionally the weights, and
+	// the triangles of the mesh into the surface, whose polygons are
+	// built over the source's threads.  The search structures are
+	// built once any other sources are appended.
+	void WeightsSource::build_surface(MDagPath& mesh_dag, bool read_weights)
+	{
+		// the positions are read in one call rather than through a vertex iterator
+		MPointArray points;
+		MStatus stat = fn_mesh.getPoints(points, MSpace::kWorld);
 		MCHECK_ERROR(stat);
 
-		MPoint position;
-		double* weights;
-		int index = 0;
-		MIntArray connected_polys;
-		MIntArray connected_edges;
-
-		for( ; !vtx_iter.isDone(); vtx_iter.next())
+		double weights[WEIGHT_COUNT];
+		for(unsigned i = 0; i < points.length() && i < vertex_count; i++)
 		{
-			position = vtx_iter.position(MSpace::kWorld, &stat);
-			MCHECK_ERROR(stat);
-			weights = get_weight(index);
-
-			WeightedVertex& cur_vert = weighted_verts[index];
-			cur_vert.set_vertex(position, weights);
-			index++;
+			Point3d point = {points[i].x, points[i].y, points[i].z};
+			if(read_weights)
+			{
+				get_weight(i, weights);
+				surface.set_vertex(i, point, weights);
+			}
+			else
+				surface.set_vertex(i, point, NULL);
 		}
 
 		// initialize triangulated mesh data
 		MIntArray tri_counts;
 		MIntArray tri_verts;
 		fn_mesh.getTriangles(tri_counts, tri_verts);
+		std::vector<int> tri_count_values(tri_counts.length());
+		std::vector<int> tri_vert_values(tri_verts.length());
+		if(!tri_count_values.empty())
+			tri_counts.get(&tri_count_values[0]);
+		if(!tri_vert_values.empty())
+			tri_verts.get(&tri_vert_values[0]);
+		surface.set_polygons(tri_counts.length(), tri_count_values.data(), tri_vert_values.data(), thread_count);
+	}
 
-		unsigned start_index = 0;
-		for(unsigned i=0; i < poly_count; i++)
-		{
-			weighted_polys[i].update_triangles(i, tri_counts[i], start_index,
-												tri_verts, weighted_verts);
-			start_index += tri_counts[i] * 3;
-		}
+	// Appends the surface of another source mesh so both are sampled through
+	// one search, returns false if its weights have a different number of channels.
+	bool WeightsSource::append_source(const WeightsSource& other)
+	{
+		return surface.append_surface(other.surface);
 	}
 
-	// Samples the weight source mesh at an arbitray position in space.
-	void WeightsSource::sample_mesh(const MPoint& sample_point, double* out_weights)
+	// Builds the closest point search tree which finds the closest point on
+	// the source surface to a sample position, and the vertex hash, then
+	// reports the footprint of the surface.
+	void WeightsSource::build_search()
 	{
-		MPointOnMesh point_info;
-		MPoint point(sample_point);
-		intersector.getClosestPoint(point, point_info);
-		int face_index = point_info.faceIndex();
-		MPoint closest_pos = MPoint(point_info.getPoint());
-		// the point returned by the mesh intersector is in the mesh's
-		// local space but our data structures are in world space
-		closest_pos *= xform_matrix;
+		surface.build_tree(thread_count);
+		surface.build_vertex_hash();
 
-		WeightedPolygon& poly = weighted_polys[face_index];
-		WeightedVertex* matching_vert = poly.get_matching_vertex(closest_pos);
-		if(matching_vert != NULL)
+		// report the footprint of the triangle data
+		char buffer[MAX_STRING_SIZE];
+		unsigned triangle_count = surface.get_triangle_count();
+		if(triangle_count > 0)
 		{
-			matching_vert->copy_weights(out_weights);
-			return;
+			sprintf_s(buffer, MAX_STRING_SIZE, "Source triangles: %u at %u bytes each (previously %u).",
+					  triangle_count, (unsigned)sizeof(WeightedTriangle),
+					  (unsigned)WeightedSurface::get_legacy_triangle_size());
+			display_msg(buffer);
+			sprintf_s(buffer, MAX_STRING_SIZE, "Source surface data: %.1f bytes per triangle in total.",
+					  (double)surface.get_memory_size() / triangle_count);
+			display_msg(buffer);
 		}
+	}
+
+	// Returns the sampled source surface.
+	const WeightedSurface& WeightsSource::get_surface() const
+	{
+		return surface;
+	}
 
-		WeightedTriangle* tri = poly.get_intersected_triangle(closest_pos);
-		tri->sample_weights(closest_pos, out_weights);
+	// Stores the source weights as 16-bit values scaled to the range of
+	// every channel and returns the largest quantization error.
+	double WeightsSource::quantize_weights()
+	{
+		return surface.quantize_weights();
+	}
+
+	// Mirrors the weights of one side of this mesh onto the other across a plane.
+	// The reflected positions of the target vertices are sampled from the surface
+	// built over the whole mesh, and only the target vertices' weights are assigned.
+	// Targets which keep their existing weights fall back to the surface's weights.
+	MStatus WeightsSource::mirror_weights(const MirrorPlane& plane,
+										  unsigned chunk_size,
+										  unsigned thread_count,
+										  bool coherent,
+										  InterpolationMode interpolation,
+										  const DistanceSettings& distance_settings,
+										  TransferStats& stats)
+	{
+		MirrorStream mirror(surface, plane);
+		stats = stream_weights(surface, mirror, chunk_size, thread_count, coherent, interpolation, distance_settings);
+
+		// the weights read by the constructor are kept on the other vertices
+		for(unsigned i = 0; i < mirror.get_target_count(); i++)
+			set_weight(mirror.get_target(i), mirror.get_target_weights(i));
+		assign_weights();
+		return MS::kSuccess;
 	}
 
 	// WeightsDestination class constructor.
@@ -197,46 +573,153 @@ namespace WeightTransferTool
 		MStatus mesh_stat = set_mesh(mesh_dag);
 		MStatus weight_attr_stat = set_weight_attribute(weight_attr_name);
 
+		vtx_iter = NULL;
+		write_index = 0;
+		existing_count = 0;
+		default_value = 0.0;
 		if(mesh_stat && weight_attr_stat)
 			is_valid = true;
 	}
 
-	// Transfers weights from the specified source to this mesh.
-	MStatus WeightsDestination::transfer_weights(WeightsSource& source)
+	// WeightsDestination class deconstructor.
+	WeightsDestination::~WeightsDestination()
 	{
-		switch(weight_attr_type)
+		if(vtx_iter != NULL)
+			delete vtx_iter;
+	}
+
+	// Transfers weights from the specified source to this mesh in chunks
+	// of the given size using the given number of threads, optionally
+	// seeding every closest point search from a nearby vertex and blending
+	// the source corners by the interpolation mode, then smooths and
+	// normalizes them as the settings ask for.  Vertices out of range may
+	// keep the attribute's current weights, which are read before resizing.
+	MStatus WeightsDestination::transfer_weights(WeightsSource& source,
+												 unsigned chunk_size,
+												 unsigned thread_count,
+												 bool coherent,
+												 InterpolationMode interpolation,
+												 const DistanceSettings& distance_settings,
+												 const SmoothSettings& smooth_settings,
+												 TransferStats& stats)
+	{
+		existing_count = 0;
+		default_value = distance_settings.default_value;
+		if(is_distance_limited(distance_settings) && distance_settings.keep_existing)
 		{
-			case MFnData::kDoubleArray:
-				weight_double_vals.setLength(vertex_count);
-				break;
-			case MFnData::kVectorArray:
-				weight_vector_vals.setLength(vertex_count);
-				break;
-			case MFnData::kPointArray:
-				weight_point_vals.setLength(vertex_count);
-				break;
-			default:
-				return MS::kFailure;
+			retrieve_weights();
+			existing_count = weight_count < vertex_count ? weight_count : vertex_count;
 		}
+		MStatus stat = resize_weights();
+		if(!stat)
+			return stat;
+		vtx_iter = new MItMeshVertex(mesh_dag, MObject::kNullObj, &stat);
+		MCHECK_ERROR(stat);
+		if(!stat)
+			return stat;
+		write_index = 0;
+		// the smoothing pass needs every vertex's weights at once
+		if(is_smoothing_enabled(smooth_settings))
+			gathered_weights.resize((size_t)vertex_count * get_channel_count());
 
-		MStatus stat;
-		MItMeshVertex vtx_iter(mesh_dag, MObject::kNullObj, &stat);
-		double* weights = new double[4];
-		unsigned index = 0;
+		stats = stream_weights(source.get_surface(), *this, chunk_size, thread_count, coherent, interpolation,
+							   distance_settings);
 
-		for(; !vtx_iter.isDone(&stat); vtx_iter.next())
-		{
-			MPoint p = vtx_iter.position(MSpace::kWorld, &stat);
-			// Sample the source mesh for the current
-			// point position and store the result.
-			source.sample_mesh(p, weights);
-			set_weight(index, weights);
-			index++;
-		}
+		delete vtx_iter;
+		vtx_iter = NULL;
+
+		if(!gathered_weights.empty())
+			smooth(smooth_settings, thread_count);
 
 		// assign weight values from array to weights attribute
 		assign_weights();
 
 		return MS::kSuccess;
 	}
+
+	// Reads the next chunk of vertex positions.
+	unsigned WeightsDestination::read_positions(Point3d* positions, unsigned max_count)
+	{
+		MStatus stat;
+		unsigned count = 0;
+		for(; count < max_count && !vtx_iter->isDone(&stat); vtx_iter->next())
+		{
+			MPoint p = vtx_iter->position(MSpace::kWorld, &stat);
+			positions[count].x = p.x;
+			positions[count].y = p.y;
+			positions[count].z = p.z;
+			count++;
+		}
+		return count;
+	}
+
+	// Writes the weights of the last chunk.
+	void WeightsDestination::write_weights(const double* weights, unsigned count)
+	{
+		if(gathered_weights.empty())
+		{
+			for(unsigned i = 0; i < count; i++)
+				set_weight(write_index++, &weights[i * WEIGHT_COUNT]);
+			return;
+		}
+		unsigned channel_count = get_channel_count();
+		for(unsigned i = 0; i < count; i++)
+		{
+			memcpy(&gathered_weights[(size_t)write_index * channel_count], &weights[i * WEIGHT_COUNT],
+				   sizeof(double) * channel_count);
+			write_index++;
+		}
+	}
+
+	// Reads the attribute's weights of the last chunk, which has not been written
+	// yet.  Vertices beyond the weights the attribute held take the default value.
+	bool WeightsDestination::read_existing_weights(double* weights, unsigned count)
+	{
+		if(existing_count == 0)
+			return false;
+		for(unsigned i = 0; i < count; i++)
+		{
+			unsigned index = write_index + i;
+			if(index < existing_count)
+			{
+				get_weight(index, &weights[i * WEIGHT_COUNT]);
+				continue;
+			}
+			for(unsigned c = 0; c < WEIGHT_COUNT; c++)
+				weights[i * WEIGHT_COUNT + c] = default_value;
+		}
+		return true;
+	}
+
+	// Runs the smoothing pass over the gathered weights.  The vertex adjacency
+	// is built from the destination polygons once, before the first iteration.
+	void WeightsDestination::smooth(const SmoothSettings& smooth_settings, unsigned thread_count)
+	{
+		VertexAdjacency adjacency;
+		if(smooth_settings.iterations > 0)
+		{
+			MIntArray poly_counts;
+			MIntArray poly_verts;
+			fn_mesh.getVertices(poly_counts, poly_verts);
+			std::vector<int> poly_count_values(poly_counts.length());
+			std::vector<int> poly_vert_values(poly_verts.length());
+			if(!poly_count_values.empty())
+				poly_counts.get(&poly_count_values[0]);
+			if(!poly_vert_values.empty())
+				poly_verts.get(&poly_vert_values[0]);
+			adjacency.build(vertex_count, poly_counts.length(), poly_count_values.data(), poly_vert_values.data());
+		}
+
+		unsigned channel_count = get_channel_count();
+		apply_smooth_settings(smooth_settings, adjacency, &gathered_weights[0], vertex_count,
+							  channel_count, thread_count);
+
+		double weights[WEIGHT_COUNT];
+		for(unsigned i = 0; i < vertex_count; i++)
+		{
+			expand_channels(&gathered_weights[(size_t)i * channel_count], channel_count, weights);
+			set_weight(i, weights);
+		}
+		std::vector<double>().swap(gathered_weights);
+	}
 }
@@ -3,16 +3,61 @@
 #define __WEIGHT_TRANSFER__
 
 #include <stdlib.h>
+#include <memory>
 
 #include <maya/MFnPlugin.h>
 #include <maya/MPxCommand.h>
 #include <maya/MArgList.h>
+#include <maya/MSyntax.h>
+#include <maya/MArgDatabase.h>
+#include <maya/MStringArray.h>
 
 #include <weightedMesh.h>
 #include <weightTransferCommon.h>
+#include <weightStream.h>
+#include <weightSmooth.h>
+#include <weightMirror.h>
+#include <systemInfo.h>
+#include <taskScheduler.h>
 
 #define PLUGIN_NAME "weightTransfer"
 
+// command flags
+#define CHUNK_SIZE_FLAG "-cs"
+#define CHUNK_SIZE_FLAG_LONG "-chunkSize"
+#define THREAD_COUNT_FLAG "-tc"
+#define THREAD_COUNT_FLAG_LONG "-threadCount"
+#define EXPORT_WEIGHTS_FLAG "-ew"
+#define EXPORT_WEIGHTS_FLAG_LONG "-exportWeights"
+#define IMPORT_WEIGHTS_FLAG "-iw"
+#define IMPORT_WEIGHTS_FLAG_LONG "-importWeights"
+#define SOURCE_WEIGHTS_FLAG "-sw"
+#define SOURCE_WEIGHTS_FLAG_LONG "-sourceWeights"
+#define SMOOTH_ITERATIONS_FLAG "-si"
+#define SMOOTH_ITERATIONS_FLAG_LONG "-smoothIterations"
+#define SMOOTH_STRENGTH_FLAG "-ss"
+#define SMOOTH_STRENGTH_FLAG_LONG "-smoothStrength"
+#define NORMALIZE_FLAG "-nw"
+#define NORMALIZE_FLAG_LONG "-normalizeWeights"
+#define COHERENT_SEARCH_FLAG "-co"
+#define COHERENT_SEARCH_FLAG_LONG "-coherentSearch"
+#define QUANTIZE_SOURCE_FLAG "-qs"
+#define QUANTIZE_SOURCE_FLAG_LONG "-quantizeSource"
+#define MIRROR_FLAG "-mi"
+#define MIRROR_FLAG_LONG "-mirror"
+#define MIRROR_INVERSE_FLAG "-mii"
+#define MIRROR_INVERSE_FLAG_LONG "-mirrorInverse"
+#define INTERPOLATION_FLAG "-ip"
+#define INTERPOLATION_FLAG_LONG "-interpolation"
+#define MAX_DISTANCE_FLAG "-md"
+#define MAX_DISTANCE_FLAG_LONG "-maxDistance"
+#define FALLOFF_FLAG "-fo"
+#define FALLOFF_FLAG_LONG "-falloff"
+#define DEFAULT_VALUE_FLAG "-dv"
+#define DEFAULT_VALUE_FLAG_LONG "-defaultValue"
+#define KEEP_EXISTING_FLAG "-ke"
+#define KEEP_EXISTING_FLAG_LONG "-keepExisting"
+
 namespace WeightTransferTool
 {
 	MDagPath get_shape_node(MItSelectionList&);			// Checks for and returns the next valid shape
@@ -23,28 +68,63 @@ namespace WeightTransferTool
 	class WeightsSource : public WeightedMesh
 	{
 		public:
-			WeightsSource(MDagPath&, MString);			// WeightsSource class constructor.
+			WeightsSource(MDagPath&, MString,			// WeightsSource class constructor, the surface is
+						  unsigned);					// built over the given number of threads.
+			WeightsSource(MDagPath&, const WeightFile&,	// WeightsSource class constructor for weights sampled
+						  unsigned);					// directly from a mapped weight file.
 			~WeightsSource(){};							// WeightsSource class deconstructor.
 
-			// source weight sample methods
-			void sample_mesh(const MPoint&, double*);	// Samples the weight source mesh at
-							 							// an arbitray position in space.
-			
+			bool append_source(const WeightsSource&);	// Appends the surface of another source mesh, returns
+														// false if its weights have a different number of channels.
+			void build_search();						// Builds the search structures over the surface.
+			const WeightedSurface& get_surface() const;	// Returns the sampled source surface.
+			double quantize_weights();					// Stores the source weights as 16-bit values and
+														// returns the largest quantization error.
+			MStatus mirror_weights(const MirrorPlane&,	// Mirrors the weights of one side of this mesh onto
+								   unsigned,			// the other across a plane, in chunks of the given
+								   unsigned,			// size using the given number of threads.
+								   bool,
+								   InterpolationMode,
+								   const DistanceSettings&,
+								   TransferStats&);
+
 		private:
-			MMatrix xform_matrix;						// the world transform matrix for this mesh.
-			WeightedPolygon* weighted_polys;			// The array of polygons that make up this mesh.
-			WeightedVertex* weighted_verts;				// The array of all vertices that make up this mesh.
-			MMeshIntersector intersector;				// The Maya mesh intersector which calculates the closest point on surface.
+			void build_surface(MDagPath&, bool);		// Reads the mesh into the surface, the weights only
+														// when requested.
+
+			WeightedSurface surface;					// The triangulated vertices and polygons that make up this mesh.
+			unsigned thread_count;						// The number of threads the surface is built over.
 	};
 
 	// this class applies weights from the
 	// source mesh to a destination mesh
-	class WeightsDestination : public WeightedMesh
+	class WeightsDestination : public WeightedMesh, public DestinationStream
 	{
 		public:
 			WeightsDestination(MDagPath&, MString);		// WeightsDestination class constructor.
-			~WeightsDestination(){};					// WeightsDestination class deconstructor.
-			MStatus transfer_weights(WeightsSource&);	// Transfers weights from the specified source to this mesh.
+			~WeightsDestination();						// WeightsDestination class deconstructor.
+			MStatus transfer_weights(WeightsSource&,	// Transfers weights from the specified source to this mesh
+									 unsigned,			// in chunks of the given size using the given number
+									 unsigned,			// of threads, optionally seeding every search from a
+									 bool,				// nearby vertex, blending the source corners by the
+									 InterpolationMode,	// interpolation mode, falling back for distant vertices,
+									 const DistanceSettings&,	// then smooths and normalizes them as the
+									 const SmoothSettings&,		// settings ask for.
+									 TransferStats&);
+
+			unsigned read_positions(Point3d*, unsigned);	// Reads the next chunk of vertex positions.
+			void write_weights(const double*, unsigned);	// Writes the weights of the last chunk.
+			bool read_existing_weights(double*, unsigned);	// Reads the attribute's weights of the last chunk.
+
+		private:
+			void smooth(const SmoothSettings&, unsigned);	// Runs the smoothing pass over the gathered weights.
+
+			MItMeshVertex* vtx_iter;					// The vertex iterator positions are read from.
+			unsigned write_index;						// The index of the next vertex to write weights to.
+			unsigned existing_count;					// The number of weights the attribute held before the transfer.
+			double default_value;						// The fallback value of vertices without an existing weight.
+			std::vector<double> gathered_weights;		// The channel weights of every vertex, kept for the
+														// smoothing pass instead of being set directly.
 	};
 
 	// The main weight transfer command class parses the
@@ -57,6 +137,19 @@ namespace WeightTransferTool
 
 			virtual MStatus doIt ( const MArgList& args );	// plug-in entry function
 			static void* creator();						// plug-in class instantiation function
+			static MSyntax new_syntax();				// plug-in command syntax function
+
+		private:
+			MStatus transfer_weight_file(const MArgDatabase&,	// Exports the weight attribute of the first selected
+										 const MStringArray&);	// mesh to a weight file, or imports one into it.
+			MStatus mirror_weights(const MArgDatabase&,	// Mirrors the weight attribute of the first selected
+								   const MStringArray&,	// mesh across the plane given by the mirror flags.
+								   unsigned, unsigned, bool,
+								   InterpolationMode,
+								   const DistanceSettings&);
+			void display_transfer_stats(const TransferStats&,	// Reports the search, memory and thread
+										bool,					// statistics of a transfer.
+										const DistanceSettings&);
 	};
 
 } // end namespace WeightTransferTool
@@ -67,7 +160,8 @@ MStatus initializePlugin( MObject obj )
 	MFnPlugin plugin( obj, "rbland", "1.0.0", "Any");
 	// register the weightTransfer plug-in command in Maya
 	MStatus status = plugin.registerCommand(PLUGIN_NAME,
-		WeightTransferTool::WeightTransfer::creator );
+		WeightTransferTool::WeightTransfer::creator,
+		WeightTransferTool::WeightTransfer::new_syntax );
 	MCHECK_ERROR(status);
 	return status;
 }
@@ -78,6 +172,8 @@ MStatus uninitializePlugin( MObject obj )
 	MFnPlugin plugin( obj );
 	MStatus status = plugin.deregisterCommand(PLUGIN_NAME);
 	MCHECK_ERROR(status);
+	// join the threads kept for parallel loops before the plug-in's code is unloaded
+	WeightTransferTool::shutdown_parallel_for();
 	return status;
 }
 
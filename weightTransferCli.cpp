@@ -0,0 +1,1283 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <weightedSurface.h>
+#include <weightStream.h>
+#include <weightMirror.h>
+#include <meshFile.h>
+#include <weightFile.h>
+#include <sourceFile.h>
+#include <weightOperator.h>
+#include <systemInfo.h>
+
+using namespace WeightTransferTool;
+
+namespace
+{
+	// the transfer modes of the command-line tool
+	enum TransferMode
+	{
+		MEMORY_MODE = 1,						// The whole destination is read and sampled at once.
+		STREAM_MODE = 2,						// The destination is read and written in chunks.
+	};
+
+	// The parsed command-line options.
+	struct CliOptions
+	{
+		std::string source_path;				// The mesh to sample attributes from.
+		std::string dest_path;					// The mesh to transfer attributes to.
+		std::string output_path;				// The destination mesh written with the transferred attributes.
+		std::string source_weights_path;		// The weight file sampled instead of the source attributes.
+		std::string weights_out_path;			// The weight file the transferred weights are written to.
+		std::string save_source_path;			// The built source file the source surface is saved to.
+		std::string operator_out_path;			// The operator file the transfer is saved to.
+		std::vector<std::string> operator_paths;	// The operator files applied in order instead of sampling.
+		std::vector<std::string> extra_source_paths;	// The meshes sampled together with the source mesh.
+		std::vector<std::string> attributes;	// The PLY vertex properties to transfer.
+		TransferMode mode;						// How the destination is read and written.
+		unsigned chunk_size;					// The number of vertices per chunk in stream mode.
+		unsigned thread_count;					// The number of sampling threads per process.
+		bool thread_count_set;					// Indicates the thread count was given.
+		unsigned process_count;					// The number of worker processes the destination is sharded over.
+		unsigned shard_index;					// The destination shard transferred by a worker process.
+		unsigned shard_count;					// The number of destination shards, zero when not a worker.
+		bool coherent;							// Indicates searches are seeded from nearby vertices.
+		bool quantize;							// Indicates the source weights are stored as 16-bit values.
+		InterpolationMode interpolation;		// How the weights of the source triangle corners are blended.
+		bool mirror;							// Indicates the source mesh is mirrored onto itself.
+		MirrorPlane mirror_plane;				// The plane the source mesh is mirrored across.
+		DistanceSettings distance_settings;		// How vertices far from the source are sampled.
+	};
+
+	// This class streams destination vertices from a mesh file into an
+	// output mesh file and/or a weight file with the sampled weights.
+	class FileDestinationStream : public DestinationStream
+	{
+		public:
+			FileDestinationStream(MeshReader& new_reader, MeshWriter* new_writer, WeightFile* new_weight_file)
+				: reader(new_reader), writer(new_writer), weight_file(new_weight_file), read_existing(false),
+				  skip_count(0), remaining_count(new_reader.get_vertex_count()) {};
+			~FileDestinationStream(){};
+
+			// Restricts the stream to a range of the destination vertices.
+			void set_range(unsigned start, unsigned count)
+			{
+				skip_count = start;
+				remaining_count = count;
+			}
+
+			// Reads the destination attributes along with the positions, so
+			// vertices out of range of the source can keep their values.
+			void set_read_existing(bool read)
+			{
+				read_existing = read;
+			}
+
+			// Reads the next chunk of vertex positions.
+			unsigned read_positions(Point3d* positions, unsigned max_count)
+			{
+				if(skip_count > 0)
+				{
+					reader.skip_vertices(skip_count);
+					skip_count = 0;
+				}
+				unsigned read_count = std::min(max_count, remaining_count);
+				if(read_existing)
+					existing_weights.resize((size_t)read_count * WEIGHT_COUNT);
+				unsigned count = reader.read_vertices(positions, read_existing ? existing_weights.data() : NULL,
+													  read_count);
+				remaining_count -= count;
+				// the positions are written back out with the weights
+				if(writer != NULL)
+					last_positions.assign(positions, positions + count);
+				return count;
+			}
+
+			// Writes the weights of the last chunk.
+			void write_weights(const double* weights, unsigned count)
+			{
+				if(writer != NULL)
+					writer->write_vertices(last_positions.data(), weights, count);
+				if(weight_file != NULL)
+					weight_file->write_weights(weights, count);
+			}
+
+			// Reads the destination attributes of the last chunk.
+			bool read_existing_weights(double* weights, unsigned count)
+			{
+				if(!read_existing)
+					return false;
+				memcpy(weights, existing_weights.data(), sizeof(double) * WEIGHT_COUNT * count);
+				return true;
+			}
+
+		private:
+			MeshReader& reader;					// The destination mesh file.
+			MeshWriter* writer;					// The output mesh file or NULL.
+			WeightFile* weight_file;				// The output weight file or NULL.
+			bool read_existing;						// Indicates the destination attributes are read.
+			unsigned skip_count;					// The number of vertices to skip before the first read.
+			unsigned remaining_count;				// The number of vertices left to read.
+			std::vector<Point3d> last_positions;	// The positions of the last chunk read.
+			std::vector<double> existing_weights;	// The destination attributes of the last chunk read.
+	};
+
+	// Prints the command-line usage.
+	void print_usage()
+	{
+		printf("usage: weightTransferCli [options] <source mesh> <destination mesh> [output mesh]\n"
+			   "       weightTransferCli [options] --mirror <plane> <mesh> [output mesh]\n"
+			   "       weightTransferCli --operator <file> [--operator <file>...] --operator-out <file>\n"
+			   "\n"
+			   "Samples per-vertex attributes of the source mesh at the closest point to every\n"
+			   "destination vertex and writes the destination mesh with the sampled attributes.\n"
+			   "Meshes can be .obj (attributes follow the vertex position), .ply or .wtm files.\n"
+			   "The source can also be a .wts file saved with --save-source, which is mapped\n"
+			   "instead of built again.\n"
+			   "The output mesh can be left out when the weights are written to a weight file.\n"
+			   "A mirrored mesh is its own source and destination.\n"
+			   "A transfer saved as an operator is applied to the attributes of its source mesh\n"
+			   "without searching it again, and a chain of operators is composed into one.\n"
+			   "\n"
+			   "options:\n"
+			   "  -t, --threads <count>       number of sampling threads per process\n"
+			   "                              (default: all hardware threads, shared by the processes)\n"
+			   "  -p, --processes <count>     shard the destination over this many worker processes\n"
+			   "                              which map one built source (default: 1)\n"
+			   "  -m, --mode <memory|stream>  read the whole destination at once, or in chunks (default: memory)\n"
+			   "  -c, --chunk-size <count>    vertices per chunk in stream mode (default: %u)\n"
+			   "  -a, --attribute <names>     comma separated PLY vertex properties to transfer\n"
+			   "                              (default: every property other than x, y and z)\n"
+			   "  -s, --source-weights <file> sample the weights of a .wtw weight file, which are\n"
+			   "                              mapped rather than read, instead of the source attributes\n"
+			   "  -w, --weights-out <file>    write the transferred weights to a .wtw weight file\n"
+			   "      --coherent              seed every closest point search with the result of the\n"
+			   "                              previous nearby vertex and walk to the closest triangle;\n"
+			   "                              the walk can stop at a different surface point than the\n"
+			   "                              exact search, so the attributes may differ from a run\n"
+			   "                              without it, most on folded or noisy source meshes\n"
+			   "  -i, --interpolation <mode>  blend the source triangle corners linearly, take the\n"
+			   "                              nearest corner, the largest value of every channel, or\n"
+			   "                              ease between corners: linear|nearest|max|smooth\n"
+			   "                              (default: linear)\n"
+			   "  -q, --quantize              store the source weights as 16-bit values scaled to the\n"
+			   "                              range of every channel, a quarter of the size of doubles\n"
+			   "      --max-distance <d>      search no further than this from every destination vertex;\n"
+			   "                              vertices beyond it take the default value\n"
+			   "      --falloff <d>           blend toward the default value over this band inside the\n"
+			   "                              maximum distance (default: 0)\n"
+			   "      --default-value <v>     the value of every attribute out of range (default: 0)\n"
+			   "      --keep-existing         vertices out of range keep the destination's attributes\n"
+			   "                              instead of taking the default value\n"
+			   "      --extra-source <mesh>   sample another source mesh together with the source mesh,\n"
+			   "                              through one search tree over all of them (repeatable)\n"
+			   "      --mirror <yz|xz|xy>     mirror the attributes of the positive side of the mesh onto\n"
+			   "                              the negative side of this plane through the origin\n"
+			   "      --mirror-inverse        mirror from the negative side onto the positive side\n"
+			   "      --save-source <file>    save the built source surface to a .wts file\n"
+			   "      --shard <index>/<count> transfer one shard of the destination to --weights-out,\n"
+			   "                              as done by the worker processes\n"
+			   "      --operator-out <file>   save the transfer as a sparse operator file, or the\n"
+			   "                              composed operators when they are given\n"
+			   "      --operator <file>       apply a saved operator to the source attributes instead of\n"
+			   "                              sampling the source (repeatable, composed in order)\n"
+			   "  -h, --help                  print this message\n", DEFAULT_CHUNK_SIZE);
+	}
+
+	// Splits a comma separated list.
+	std::vector<std::string> split_list(const std::string& list)
+	{
+		std::vector<std::string> items;
+		size_t start = 0;
+		while(start <= list.size())
+		{
+			size_t end = list.find(',', start);
+			if(end == std::string::npos)
+				end = list.size();
+			if(end > start)
+				items.push_back(list.substr(start, end - start));
+			start = end + 1;
+		}
+		return items;
+	}
+
+	// Parses a positive integer option value.
+	bool parse_count(const char* value, unsigned& count)
+	{
+		char* end;
+		unsigned long parsed = strtoul(value, &end, 10);
+		if(end == value || *end != '\0' || parsed == 0)
+			return false;
+		count = (unsigned)parsed;
+		return true;
+	}
+
+	// Parses a number option value.
+	bool parse_number(const char* value, double& number)
+	{
+		char* end;
+		number = strtod(value, &end);
+		return end != value && *end == '\0';
+	}
+
+	// Parses the command-line arguments, returns false if they are invalid.
+	bool parse_arguments(int argc, char** argv, CliOptions& options)
+	{
+		options.mode = MEMORY_MODE;
+		options.chunk_size = DEFAULT_CHUNK_SIZE;
+		options.thread_count = get_processor_count();
+		options.thread_count_set = false;
+		options.process_count = 1;
+		options.shard_index = 0;
+		options.shard_count = 0;
+		options.coherent = false;
+		options.quantize = false;
+		options.interpolation = LINEAR_INTERPOLATION;
+		options.mirror = false;
+		DistanceSettings no_limit = {-1.0, 0.0, false, 0.0};
+		options.distance_settings = no_limit;
+		bool distance_option_set = false;
+		std::string mirror_plane_name;
+		bool mirror_inverse = false;
+		std::vector<std::string> paths;
+
+		for(int i = 1; i < argc; i++)
+		{
+			std::string arg(argv[i]);
+			bool has_value = i + 1 < argc;
+
+			if(arg == "-h" || arg == "--help")
+				return false;
+			else if((arg == "-t" || arg == "--threads") && has_value)
+			{
+				if(!parse_count(argv[++i], options.thread_count))
+				{
+					fprintf(stderr, "The thread count must be a positive number.\n");
+					return false;
+				}
+				options.thread_count_set = true;
+			}
+			else if((arg == "-p" || arg == "--processes") && has_value)
+			{
+				if(!parse_count(argv[++i], options.process_count))
+				{
+					fprintf(stderr, "The process count must be a positive number.\n");
+					return false;
+				}
+			}
+			else if(arg == "--shard" && has_value)
+			{
+				std::string shard(argv[++i]);
+				size_t slash = shard.find('/');
+				char* end;
+				options.shard_index = (unsigned)strtoul(shard.c_str(), &end, 10);
+				if(slash == std::string::npos || end != shard.c_str() + slash ||
+				   !parse_count(shard.c_str() + slash + 1, options.shard_count) ||
+				   options.shard_index >= options.shard_count)
+				{
+					fprintf(stderr, "The shard must be given as <index>/<count> with index below count.\n");
+					return false;
+				}
+			}
+			else if((arg == "-c" || arg == "--chunk-size") && has_value)
+			{
+				if(!parse_count(argv[++i], options.chunk_size))
+				{
+					fprintf(stderr, "The chunk size must be a positive number.\n");
+					return false;
+				}
+			}
+			else if((arg == "-m" || arg == "--mode") && has_value)
+			{
+				std::string mode(argv[++i]);
+				if(mode == "memory")
+					options.mode = MEMORY_MODE;
+				else if(mode == "stream")
+					options.mode = STREAM_MODE;
+				else
+				{
+					fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
+					return false;
+				}
+			}
+			else if((arg == "-a" || arg == "--attribute") && has_value)
+				options.attributes = split_list(argv[++i]);
+			else if((arg == "-s" || arg == "--source-weights") && has_value)
+				options.source_weights_path = argv[++i];
+			else if((arg == "-w" || arg == "--weights-out") && has_value)
+				options.weights_out_path = argv[++i];
+			else if(arg == "--coherent")
+				options.coherent = true;
+			else if((arg == "-i" || arg == "--interpolation") && has_value)
+			{
+				if(!parse_interpolation_mode(argv[++i], options.interpolation))
+				{
+					fprintf(stderr, "The interpolation must be linear, nearest, max or smooth.\n");
+					return false;
+				}
+			}
+			else if(arg == "--max-distance" && has_value)
+			{
+				if(!parse_number(argv[++i], options.distance_settings.max_distance) ||
+				   options.distance_settings.max_distance < 0.0)
+				{
+					fprintf(stderr, "The maximum distance must be a number of at least zero.\n");
+					return false;
+				}
+			}
+			else if(arg == "--falloff" && has_value)
+			{
+				if(!parse_number(argv[++i], options.distance_settings.falloff) ||
+				   options.distance_settings.falloff < 0.0)
+				{
+					fprintf(stderr, "The falloff must be a number of at least zero.\n");
+					return false;
+				}
+				distance_option_set = true;
+			}
+			else if(arg == "--default-value" && has_value)
+			{
+				if(!parse_number(argv[++i], options.distance_settings.default_value))
+				{
+					fprintf(stderr, "The default value must be a number.\n");
+					return false;
+				}
+				distance_option_set = true;
+			}
+			else if(arg == "--keep-existing")
+			{
+				options.distance_settings.keep_existing = true;
+				distance_option_set = true;
+			}
+			else if(arg == "-q" || arg == "--quantize")
+				options.quantize = true;
+			else if(arg == "--extra-source" && has_value)
+				options.extra_source_paths.push_back(argv[++i]);
+			else if(arg == "--mirror" && has_value)
+			{
+				mirror_plane_name = argv[++i];
+				options.mirror = true;
+			}
+			else if(arg == "--mirror-inverse")
+				mirror_inverse = true;
+			else if(arg == "--save-source" && has_value)
+				options.save_source_path = argv[++i];
+			else if(arg == "--operator-out" && has_value)
+				options.operator_out_path = argv[++i];
+			else if(arg == "--operator" && has_value)
+				options.operator_paths.push_back(argv[++i]);
+			else if(!arg.empty() && arg[0] == '-')
+			{
+				fprintf(stderr, "Unknown or incomplete option: %s\n", arg.c_str());
+				return false;
+			}
+			else
+				paths.push_back(arg);
+		}
+
+		if(distance_option_set && !is_distance_limited(options.distance_settings))
+		{
+			fprintf(stderr, "The falloff, default value and keep existing options require a maximum distance.\n");
+			return false;
+		}
+
+		if(mirror_inverse && !options.mirror)
+		{
+			fprintf(stderr, "The mirror inverse option requires a mirror plane.\n");
+			return false;
+		}
+
+		bool use_operator = !options.operator_paths.empty();
+		bool save_operator = !options.operator_out_path.empty();
+		if(use_operator || save_operator)
+		{
+			if(options.mirror || options.process_count > 1 || options.shard_count > 0)
+			{
+				fprintf(stderr, "An operator is built and applied by one process and cannot mirror a mesh.\n");
+				return false;
+			}
+			if(!use_operator && !is_linear_transfer(options.interpolation, options.distance_settings))
+			{
+				fprintf(stderr, "An operator only holds linear transfers, without max interpolation, a default "
+						"value or kept attributes.\n");
+				return false;
+			}
+			// operators are composed into an operator file without any meshes
+			if(use_operator && save_operator && paths.empty())
+				return true;
+		}
+
+		if(options.mirror)
+		{
+			if(!parse_mirror_plane(mirror_plane_name, mirror_inverse, options.mirror_plane))
+			{
+				fprintf(stderr, "The mirror plane must be yz, xz or xy.\n");
+				return false;
+			}
+			if(options.process_count > 1 || options.shard_count > 0 || !options.extra_source_paths.empty())
+			{
+				fprintf(stderr, "A mirrored mesh cannot be sharded or combined with extra source meshes.\n");
+				return false;
+			}
+			// a mirrored mesh is its own destination
+			if(paths.size() != 2 && (paths.size() != 1 || options.weights_out_path.empty()))
+				return false;
+			options.source_path = paths[0];
+			options.dest_path = paths[0];
+			if(paths.size() == 2)
+				options.output_path = paths[1];
+			return true;
+		}
+
+		// the output mesh is optional when the weights go to a weight file or the transfer to an operator file
+		if(paths.size() != 3 && (paths.size() != 2 || (options.weights_out_path.empty() && !save_operator)))
+			return false;
+		options.source_path = paths[0];
+		options.dest_path = paths[1];
+		if(paths.size() == 3)
+			options.output_path = paths[2];
+
+		// a worker writes its shard of the weights only
+		if(options.shard_count > 0 && (options.weights_out_path.empty() || !options.output_path.empty()))
+		{
+			fprintf(stderr, "A shard is written to a weight file given with --weights-out only.\n");
+			return false;
+		}
+		if(options.shard_count > 0 && options.process_count > 1)
+		{
+			fprintf(stderr, "A shard cannot be split over more processes.\n");
+			return false;
+		}
+		// coherent seeds follow the tasks of a process, so shards would not match a single process run
+		if(options.coherent && (options.process_count > 1 || options.shard_count > 0))
+		{
+			fprintf(stderr, "A coherent search runs in one process and cannot be sharded.\n");
+			return false;
+		}
+		// the hardware threads are shared by the worker processes unless a count is given
+		if(options.process_count > 1 && !options.thread_count_set)
+			options.thread_count = std::max(1u, options.thread_count / options.process_count);
+		return true;
+	}
+
+	// Returns true if a path ends with the given extension, ignoring case.
+	bool has_extension(const std::string& path, const char* extension)
+	{
+		size_t length = strlen(extension);
+		if(path.size() < length)
+			return false;
+		for(size_t i = 0; i < length; i++)
+			if(tolower((unsigned char)path[path.size() - length + i]) != extension[i])
+				return false;
+		return true;
+	}
+
+	// Returns the first vertex and vertex count of a destination shard.  The vertices are split into
+	// contiguous ranges whose sizes differ by at most one so the shards take similar time.
+	void get_shard_range(unsigned vertex_count, unsigned shard_count, unsigned shard,
+						 unsigned& start, unsigned& count)
+	{
+		unsigned base_size = vertex_count / shard_count;
+		unsigned remainder = vertex_count % shard_count;
+		start = shard * base_size + std::min(shard, remainder);
+		count = base_size + (shard < remainder ? 1 : 0);
+	}
+
+	// Returns the path of a temporary file next to an output file.
+	std::string get_temporary_path(const CliOptions& options, const std::string& suffix)
+	{
+		const std::string& output = options.weights_out_path.empty() ? options.output_path :
+																	   options.weights_out_path;
+		return output + suffix;
+	}
+
+	// Returns the seconds elapsed since a start time.
+	double seconds_since(const std::chrono::steady_clock::time_point& start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Prints the load balance of every transfer thread.  Busy time well below the
+	// sampling time on some threads means the transfer is limited by imbalance.
+	void print_thread_stats(const TransferStats& stats)
+	{
+		for(unsigned t = 0; t < stats.thread_stats.size(); t++)
+		{
+			const ThreadStats& thread = stats.thread_stats[t];
+			double busy_percent = stats.sample_seconds > 0.0 ? 100.0 * thread.busy_seconds / stats.sample_seconds : 0.0;
+			printf("Thread %u: busy %.3f s (%.0f%%), %u tasks, %u stolen\n",
+				   t, thread.busy_seconds, busy_percent, thread.task_count, thread.steal_count);
+		}
+	}
+
+	// Prints the search, memory and thread statistics of a transfer.
+	void print_transfer_stats(const CliOptions& options, const TransferStats& stats)
+	{
+		printf("Vertices matched to a coincident source vertex: %u of %u\n",
+			   stats.matched_count, stats.vertex_count);
+		if(options.coherent)
+			printf("Closest points found by the seeded walk: %u of %u\n",
+				   stats.walked_count, stats.vertex_count - stats.matched_count);
+		if(is_distance_limited(options.distance_settings))
+			printf("Vertices beyond the maximum distance: %u of %u\n", stats.outside_count, stats.vertex_count);
+		printf("Source faces built on demand: %u of %u\n", stats.built_face_count, stats.face_count);
+		printf("Peak resident set: %.1f MB\n", stats.peak_resident_size / (1024.0 * 1024.0));
+		print_thread_stats(stats);
+	}
+
+	// The source surface, either built from a mesh or mapped from a built source file.
+	struct SourceData
+	{
+		WeightedSurface built;					// The surface built from a source mesh.
+		SourceFile mapped;						// The mapped built source file.
+		WeightFile weights;						// The mapped source weight file.
+		const WeightedSurface* surface;			// The surface which is sampled.
+		std::vector<std::string> channel_names;	// The names of the weight channels.
+	};
+
+	// The files the transferred weights are written to.
+	struct OutputFiles
+	{
+		MeshWriter writer;						// The output mesh file.
+		WeightFile weights;						// The output weight file.
+		bool write_mesh;						// Indicates an output mesh is written.
+		bool write_weight_file;					// Indicates an output weight file is written.
+	};
+
+	// Names the channels of weights without attribute names, such as those of
+	// a weight file, like the ones of a Maya attribute.
+	void set_default_channel_names(unsigned channel_count, std::vector<std::string>& channel_names)
+	{
+		const char* default_names[WEIGHT_COUNT] = {"w0", "w1", "w2", "w3"};
+		channel_names.assign(default_names, default_names + channel_count);
+	}
+
+	// Reads an extra source mesh and appends it to the source surface, returns false on failure.
+	bool append_source(const CliOptions& options, const std::string& path, WeightedSurface& surface)
+	{
+		MeshReader reader;
+		WeightedSurface piece;
+		if(!reader.open(path.c_str(), options.attributes))
+		{
+			fprintf(stderr, "%s\n", reader.get_error().c_str());
+			return false;
+		}
+		if(reader.get_channel_count() == 0)
+		{
+			fprintf(stderr, "The source mesh has no vertex attributes to transfer: %s\n", path.c_str());
+			return false;
+		}
+		if(!load_surface(reader, piece, options.thread_count))
+		{
+			fprintf(stderr, "The source mesh has invalid vertex or face data: %s\n", path.c_str());
+			return false;
+		}
+		if(!surface.append_surface(piece))
+		{
+			fprintf(stderr, "The source mesh has %u attributes but the first source has %u: %s\n",
+					piece.get_channel_count(), surface.get_channel_count(), path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// Builds the source surface, or maps a built source file, returns false on failure.
+	bool load_source(const CliOptions& options, SourceData& source)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool use_weight_file = !options.source_weights_path.empty();
+		if(!options.extra_source_paths.empty() && (use_weight_file || has_extension(options.source_path, ".wts")))
+		{
+			fprintf(stderr, "Extra source meshes can only be combined with a source mesh and its attributes.\n");
+			return false;
+		}
+		if(has_extension(options.source_path, ".wts"))
+		{
+			if(use_weight_file)
+			{
+				fprintf(stderr, "A built source file already holds its weights.\n");
+				return false;
+			}
+			if(!source.mapped.open(options.source_path.c_str()))
+			{
+				fprintf(stderr, "%s\n", source.mapped.get_error().c_str());
+				return false;
+			}
+			source.surface = &source.mapped.get_surface();
+			if(options.quantize && !source.surface->is_quantized())
+			{
+				fprintf(stderr, "A built source file is quantized when it is saved with --quantize.\n");
+				return false;
+			}
+		}
+		else
+		{
+			MeshReader source_reader;
+			if(!source_reader.open(options.source_path.c_str(), options.attributes))
+			{
+				fprintf(stderr, "%s\n", source_reader.get_error().c_str());
+				return false;
+			}
+			if(use_weight_file)
+			{
+				if(!source.weights.open(options.source_weights_path.c_str(), true))
+				{
+					fprintf(stderr, "%s\n", source.weights.get_error().c_str());
+					return false;
+				}
+				if(source.weights.get_vertex_count() != source_reader.get_vertex_count())
+				{
+					fprintf(stderr, "The source weight file has %u vertices but the source mesh has %u.\n",
+							source.weights.get_vertex_count(), source_reader.get_vertex_count());
+					return false;
+				}
+			}
+			else if(source_reader.get_channel_count() == 0)
+			{
+				fprintf(stderr, "The source mesh has no vertex attributes to transfer.\n");
+				return false;
+			}
+			if(!load_surface(source_reader, source.built, options.thread_count))
+			{
+				fprintf(stderr, "The source mesh has invalid vertex or face data.\n");
+				return false;
+			}
+			// the mapped weights are sampled in place
+			if(use_weight_file)
+				source.built.set_weight_buffer(source.weights.get_weights(), source.weights.get_channel_count());
+			else
+				source.channel_names = source_reader.get_attribute_names();
+			// extra source meshes are appended so one search tree covers every source
+			for(unsigned i = 0; i < options.extra_source_paths.size(); i++)
+				if(!append_source(options, options.extra_source_paths[i], source.built))
+					return false;
+			source.built.build_tree(options.thread_count);
+			source.built.build_vertex_hash();
+			if(options.quantize)
+				printf("Source weights quantized to 16 bits, largest error: %g\n", source.built.quantize_weights());
+			source.surface = &source.built;
+		}
+
+		if(source.channel_names.empty())
+			set_default_channel_names(source.surface->get_channel_count(), source.channel_names);
+		printf("Source: %u vertices, %u triangles, %s in %.3f s\n",
+			   source.surface->get_vertex_count(), source.surface->get_triangle_count(),
+			   source.surface == &source.built ? "built" : "mapped", seconds_since(start));
+
+		if(!options.save_source_path.empty())
+		{
+			SourceFile saver;
+			if(!saver.save(options.save_source_path.c_str(), *source.surface))
+			{
+				fprintf(stderr, "%s\n", saver.get_error().c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Creates the output mesh and weight file for the given number of vertices, returns false on failure.
+	bool open_outputs(const CliOptions& options, const MeshReader& dest_reader, unsigned vertex_count,
+					  unsigned channel_count, const std::vector<std::string>& channel_names, OutputFiles& outputs)
+	{
+		outputs.write_mesh = !options.output_path.empty();
+		outputs.write_weight_file = !options.weights_out_path.empty();
+		if(outputs.write_mesh && !outputs.writer.open(options.output_path.c_str(), vertex_count,
+													  dest_reader.get_face_count(), channel_count,
+													  channel_names))
+		{
+			fprintf(stderr, "%s\n", outputs.writer.get_error().c_str());
+			return false;
+		}
+		if(outputs.write_weight_file && !outputs.weights.create(options.weights_out_path.c_str(),
+																vertex_count, channel_count))
+		{
+			fprintf(stderr, "%s\n", outputs.weights.get_error().c_str());
+			return false;
+		}
+		// weights which were written are not needed again
+		if(options.mode == STREAM_MODE)
+			outputs.weights.set_release_pages(true);
+		return true;
+	}
+
+	// Finishes the output files, copying the destination faces to the output mesh.
+	bool close_outputs(MeshReader& dest_reader, OutputFiles& outputs)
+	{
+		if(outputs.write_weight_file && !outputs.weights.close())
+		{
+			fprintf(stderr, "%s\n", outputs.weights.get_error().c_str());
+			return false;
+		}
+		if(outputs.write_mesh)
+		{
+			// the destination faces are copied to the output unchanged
+			std::vector<int> face_verts;
+			while(dest_reader.read_face(face_verts))
+				outputs.writer.write_face(face_verts);
+			if(dest_reader.has_face_error())
+			{
+				fprintf(stderr, "%s\n", dest_reader.get_error().c_str());
+				outputs.writer.close();
+				return false;
+			}
+			if(!outputs.writer.close())
+			{
+				fprintf(stderr, "%s\n", outputs.writer.get_error().c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Returns the number of destination vertices processed per chunk.
+	unsigned get_chunk_size(const CliOptions& options, MeshReader& dest_reader, unsigned vertex_count)
+	{
+		if(options.mode == MEMORY_MODE)
+			return vertex_count > 0 ? vertex_count : 1;
+		// vertices which were read are not needed again
+		dest_reader.set_release_pages(true);
+		return options.chunk_size;
+	}
+
+	// Transfers the weights of the whole destination, or of one shard of it, in this process.
+	// The destination attributes are only read when vertices out of range keep them.
+	int run_transfer(const CliOptions& options, const SourceData& source)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool keep_existing = is_distance_limited(options.distance_settings) && options.distance_settings.keep_existing;
+		std::vector<std::string> no_attributes;
+		MeshReader dest_reader;
+		if(!dest_reader.open(options.dest_path.c_str(), keep_existing ? options.attributes : no_attributes))
+		{
+			fprintf(stderr, "%s\n", dest_reader.get_error().c_str());
+			return 1;
+		}
+		if(keep_existing && dest_reader.get_channel_count() != source.surface->get_channel_count())
+		{
+			fprintf(stderr, "The destination mesh has %u attributes to keep but the source has %u.\n",
+					dest_reader.get_channel_count(), source.surface->get_channel_count());
+			return 1;
+		}
+		unsigned range_start = 0;
+		unsigned range_count = dest_reader.get_vertex_count();
+		if(options.shard_count > 0)
+			get_shard_range(dest_reader.get_vertex_count(), options.shard_count, options.shard_index,
+							range_start, range_count);
+
+		OutputFiles outputs;
+		if(!open_outputs(options, dest_reader, range_count, source.surface->get_channel_count(),
+						 source.channel_names, outputs))
+			return 1;
+		unsigned chunk_size = get_chunk_size(options, dest_reader, range_count);
+
+		FileDestinationStream dest(dest_reader, outputs.write_mesh ? &outputs.writer : NULL,
+								   outputs.write_weight_file ? &outputs.weights : NULL);
+		dest.set_range(range_start, range_count);
+		dest.set_read_existing(keep_existing);
+		TransferStats stats = stream_weights(*source.surface, dest, chunk_size, options.thread_count,
+											 options.coherent, options.interpolation, options.distance_settings);
+		if(!close_outputs(dest_reader, outputs))
+			return 1;
+
+		if(options.shard_count > 0)
+			printf("Shard %u of %u: ", options.shard_index + 1, options.shard_count);
+		printf("Transferred %u vertices in %.3f s using %u threads and %u chunks\n",
+			   stats.vertex_count, seconds_since(start), options.thread_count, stats.chunk_count);
+		print_transfer_stats(options, stats);
+		return 0;
+	}
+
+	// Mirrors the attributes of one side of the source mesh onto its other side.  The
+	// surface built from the mesh is the source and only the reflected positions of the
+	// target side are sampled.  The other vertices keep the values read from the mesh
+	// or source weight file, so they are written unchanged even when quantized.  The
+	// mesh is read again and written in chunks, taking the mirrored weights of the
+	// targets in every chunk, so in stream mode the surface is the only full copy.
+	int run_mirror(const CliOptions& options, const SourceData& source)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if(source.surface != &source.built)
+		{
+			fprintf(stderr, "A mirrored mesh is read from a mesh file rather than a built source file.\n");
+			return 1;
+		}
+		bool use_weight_file = !options.source_weights_path.empty();
+		std::vector<std::string> no_attributes;
+		MeshReader mesh_reader;
+		if(!mesh_reader.open(options.source_path.c_str(), use_weight_file ? no_attributes : options.attributes))
+		{
+			fprintf(stderr, "%s\n", mesh_reader.get_error().c_str());
+			return 1;
+		}
+		unsigned vertex_count = mesh_reader.get_vertex_count();
+		OutputFiles outputs;
+		if(!open_outputs(options, mesh_reader, vertex_count, source.surface->get_channel_count(),
+						 source.channel_names, outputs))
+			return 1;
+
+		MirrorStream mirror(*source.surface, options.mirror_plane);
+		unsigned target_count = mirror.get_target_count();
+		unsigned chunk_size = options.mode == MEMORY_MODE ? std::max(1u, target_count) : options.chunk_size;
+		TransferStats stats = stream_weights(*source.surface, mirror, chunk_size, options.thread_count,
+											 options.coherent, options.interpolation, options.distance_settings);
+
+		// the targets are in vertex order, so every chunk takes the next run of them
+		unsigned write_size = std::min(get_chunk_size(options, mesh_reader, vertex_count), std::max(1u, vertex_count));
+		std::vector<Point3d> positions(write_size);
+		std::vector<double> weights((size_t)write_size * WEIGHT_COUNT);
+		unsigned channel_count = use_weight_file ? source.weights.get_channel_count() : 0;
+		unsigned target = 0;
+		for(unsigned first = 0; first < vertex_count;)
+		{
+			unsigned count = mesh_reader.read_vertices(positions.data(), use_weight_file ? NULL : weights.data(),
+													   write_size);
+			if(count == 0)
+				break;
+			for(unsigned i = 0; i < count && use_weight_file; i++)
+				expand_channels(&source.weights.get_weights()[(size_t)(first + i) * channel_count], channel_count,
+								&weights[(size_t)i * WEIGHT_COUNT]);
+			for(; target < target_count && mirror.get_target(target) < first + count; target++)
+				memcpy(&weights[(size_t)(mirror.get_target(target) - first) * WEIGHT_COUNT],
+					   mirror.get_target_weights(target), sizeof(double) * WEIGHT_COUNT);
+
+			if(outputs.write_mesh)
+				outputs.writer.write_vertices(positions.data(), weights.data(), count);
+			if(outputs.write_weight_file)
+				outputs.weights.write_weights(weights.data(), count);
+			first += count;
+		}
+		if(!close_outputs(mesh_reader, outputs))
+			return 1;
+
+		printf("Mirrored %u of %u vertices in %.3f s using %u threads and %u chunks\n",
+			   target_count, vertex_count, seconds_since(start), options.thread_count, stats.chunk_count);
+		print_transfer_stats(options, stats);
+		return 0;
+	}
+
+	// Returns the WEIGHT_COUNT expanded weights of every vertex of a source surface,
+	// which an operator built over the surface is applied to.
+	void get_surface_values(const WeightedSurface& surface, std::vector<double>& values)
+	{
+		values.resize((size_t)surface.get_vertex_count() * WEIGHT_COUNT);
+		for(unsigned i = 0; i < surface.get_vertex_count(); i++)
+			surface.copy_weights(i, &values[(size_t)i * WEIGHT_COUNT]);
+	}
+
+	// Reads the weights of the source vertices an operator is applied to, WEIGHT_COUNT
+	// expanded values per vertex, from the source mesh's attributes, a source weight file
+	// or a built source file, without building a surface.  Returns false on failure.
+	bool read_source_values(const CliOptions& options, std::vector<double>& values, unsigned& channel_count,
+							std::vector<std::string>& channel_names)
+	{
+		bool use_weight_file = !options.source_weights_path.empty();
+		if(has_extension(options.source_path, ".wts"))
+		{
+			SourceFile mapped;
+			if(use_weight_file || !mapped.open(options.source_path.c_str()))
+			{
+				fprintf(stderr, "%s\n", use_weight_file ? "A built source file already holds its weights." :
+														  mapped.get_error().c_str());
+				return false;
+			}
+			channel_count = mapped.get_surface().get_channel_count();
+			get_surface_values(mapped.get_surface(), values);
+			set_default_channel_names(channel_count, channel_names);
+			return true;
+		}
+
+		std::vector<std::string> no_attributes;
+		MeshReader source_reader;
+		if(!source_reader.open(options.source_path.c_str(), use_weight_file ? no_attributes : options.attributes))
+		{
+			fprintf(stderr, "%s\n", source_reader.get_error().c_str());
+			return false;
+		}
+		unsigned vertex_count = source_reader.get_vertex_count();
+		values.resize((size_t)vertex_count * WEIGHT_COUNT);
+		if(use_weight_file)
+		{
+			WeightFile weights;
+			if(!weights.open(options.source_weights_path.c_str(), true))
+			{
+				fprintf(stderr, "%s\n", weights.get_error().c_str());
+				return false;
+			}
+			if(weights.get_vertex_count() != vertex_count)
+			{
+				fprintf(stderr, "The source weight file has %u vertices but the source mesh has %u.\n",
+						weights.get_vertex_count(), vertex_count);
+				return false;
+			}
+			channel_count = weights.get_channel_count();
+			for(unsigned i = 0; i < vertex_count; i++)
+				expand_channels(&weights.get_weights()[(size_t)i * channel_count], channel_count,
+								&values[(size_t)i * WEIGHT_COUNT]);
+			set_default_channel_names(channel_count, channel_names);
+			return true;
+		}
+
+		channel_count = source_reader.get_channel_count();
+		if(channel_count == 0)
+		{
+			fprintf(stderr, "The source mesh has no vertex attributes to transfer.\n");
+			return false;
+		}
+		std::vector<Point3d> positions(vertex_count);
+		source_reader.read_vertices(positions.data(), values.data(), vertex_count);
+		channel_names = source_reader.get_attribute_names();
+		return true;
+	}
+
+	// Applies an operator to the source weights, WEIGHT_COUNT expanded values per source
+	// vertex, and writes the destination mesh with the results to the outputs.  The
+	// operator's rows must be the destination vertices and its columns the source
+	// vertices.  Returns false on failure.
+	bool write_applied_operator(const CliOptions& options, const WeightOperator& transfer_operator,
+								const std::vector<double>& source_values, unsigned channel_count,
+								const std::vector<std::string>& channel_names)
+	{
+		std::vector<std::string> no_attributes;
+		MeshReader dest_reader;
+		if(!dest_reader.open(options.dest_path.c_str(), no_attributes))
+		{
+			fprintf(stderr, "%s\n", dest_reader.get_error().c_str());
+			return false;
+		}
+		unsigned vertex_count = dest_reader.get_vertex_count();
+		unsigned source_count = (unsigned)(source_values.size() / WEIGHT_COUNT);
+		if(transfer_operator.get_row_count() != vertex_count || transfer_operator.get_column_count() != source_count)
+		{
+			fprintf(stderr, "The operator maps %u source vertices to %u but the meshes have %u and %u.\n",
+					transfer_operator.get_column_count(), transfer_operator.get_row_count(), source_count,
+					vertex_count);
+			return false;
+		}
+
+		OutputFiles outputs;
+		if(!open_outputs(options, dest_reader, vertex_count, channel_count, channel_names, outputs))
+			return false;
+		std::vector<double> weights((size_t)vertex_count * WEIGHT_COUNT);
+		transfer_operator.apply(source_values.data(), WEIGHT_COUNT, weights.data(), options.thread_count);
+		std::vector<Point3d> positions(vertex_count);
+		dest_reader.read_vertices(positions.data(), NULL, vertex_count);
+		if(outputs.write_mesh)
+			outputs.writer.write_vertices(positions.data(), weights.data(), vertex_count);
+		if(outputs.write_weight_file)
+			outputs.weights.write_weights(weights.data(), vertex_count);
+		return close_outputs(dest_reader, outputs);
+	}
+
+	// Builds the operator of the transfer from the source to the destination and saves it.
+	// The destination is searched exactly as a transfer searches it, but the source vertices
+	// and coefficients of every destination vertex are kept rather than its weights.  When
+	// an output is given the operator is applied to the source weights to write it.
+	int run_operator_build(const CliOptions& options, const SourceData& source)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<std::string> no_attributes;
+		MeshReader dest_reader;
+		if(!dest_reader.open(options.dest_path.c_str(), no_attributes))
+		{
+			fprintf(stderr, "%s\n", dest_reader.get_error().c_str());
+			return 1;
+		}
+		unsigned vertex_count = dest_reader.get_vertex_count();
+		FileDestinationStream dest(dest_reader, NULL, NULL);
+		WeightOperator transfer_operator;
+		TransferStats stats = stream_operator(*source.surface, dest, get_chunk_size(options, dest_reader, vertex_count),
+											  options.thread_count, options.coherent, options.interpolation,
+											  options.distance_settings, transfer_operator);
+		if(!transfer_operator.save(options.operator_out_path.c_str()))
+		{
+			fprintf(stderr, "%s\n", transfer_operator.get_error().c_str());
+			return 1;
+		}
+		printf("Built an operator of %u rows and %llu coefficients in %.3f s using %u threads and %u chunks\n",
+			   transfer_operator.get_row_count(), (unsigned long long)transfer_operator.get_entry_count(),
+			   seconds_since(start), options.thread_count, stats.chunk_count);
+		print_transfer_stats(options, stats);
+
+		if(options.output_path.empty() && options.weights_out_path.empty())
+			return 0;
+		std::vector<double> source_values;
+		get_surface_values(*source.surface, source_values);
+		start = std::chrono::steady_clock::now();
+		if(!write_applied_operator(options, transfer_operator, source_values, source.surface->get_channel_count(),
+								   source.channel_names))
+			return 1;
+		printf("Applied the operator to %u vertices in %.3f s\n", vertex_count, seconds_since(start));
+		return 0;
+	}
+
+	// Maps the operator files and composes them in order into one operator, which is
+	// saved when asked and applied to the source weights when meshes are given.  The
+	// source is never searched, so the transfer runs at the speed the weights stream
+	// through memory however many transfers the chain holds.
+	int run_operator(const CliOptions& options)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		WeightOperator chain;
+		if(!chain.open(options.operator_paths[0].c_str()))
+		{
+			fprintf(stderr, "%s\n", chain.get_error().c_str());
+			return 1;
+		}
+		for(unsigned i = 1; i < options.operator_paths.size(); i++)
+		{
+			WeightOperator next;
+			if(!next.open(options.operator_paths[i].c_str()) || !chain.compose(chain, next, options.thread_count))
+			{
+				fprintf(stderr, "%s: %s\n", options.operator_paths[i].c_str(),
+						(next.get_error().empty() ? chain.get_error() : next.get_error()).c_str());
+				return 1;
+			}
+		}
+		printf("Operator: %u source vertices to %u, %llu coefficients, %s in %.3f s\n",
+			   chain.get_column_count(), chain.get_row_count(), (unsigned long long)chain.get_entry_count(),
+			   options.operator_paths.size() > 1 ? "composed" : "mapped", seconds_since(start));
+		if(!options.operator_out_path.empty() && !chain.save(options.operator_out_path.c_str()))
+		{
+			fprintf(stderr, "%s\n", chain.get_error().c_str());
+			return 1;
+		}
+		if(options.dest_path.empty())
+			return 0;
+
+		start = std::chrono::steady_clock::now();
+		std::vector<double> source_values;
+		unsigned channel_count;
+		std::vector<std::string> channel_names;
+		if(!read_source_values(options, source_values, channel_count, channel_names) ||
+		   !write_applied_operator(options, chain, source_values, channel_count, channel_names))
+			return 1;
+		printf("Applied the operator to %u vertices in %.3f s using %u threads\n",
+			   chain.get_row_count(), seconds_since(start), options.thread_count);
+		printf("Peak resident set: %.1f MB\n", get_peak_resident_size() / (1024.0 * 1024.0));
+		return 0;
+	}
+
+	// Returns the worker process command which transfers one destination shard.
+	std::vector<std::string> get_worker_command(const CliOptions& options, const char* program,
+												const std::string& source_path, unsigned shard,
+												const std::string& shard_path)
+	{
+		char shard_arg[64];
+		char thread_arg[32];
+		char chunk_arg[32];
+		sprintf(shard_arg, "%u/%u", shard, options.process_count);
+		sprintf(thread_arg, "%u", options.thread_count);
+		sprintf(chunk_arg, "%u", options.chunk_size);
+
+		std::vector<std::string> command;
+		command.push_back(program);
+		command.push_back("--shard");
+		command.push_back(shard_arg);
+		command.push_back("--threads");
+		command.push_back(thread_arg);
+		command.push_back("--chunk-size");
+		command.push_back(chunk_arg);
+		command.push_back("--mode");
+		command.push_back(options.mode == STREAM_MODE ? "stream" : "memory");
+		const char* interpolation_names[] = {"", "linear", "nearest", "max", "smooth"};
+		command.push_back("--interpolation");
+		command.push_back(interpolation_names[options.interpolation]);
+		if(is_distance_limited(options.distance_settings))
+		{
+			// the values are printed exactly so the workers sample like one process
+			char distance_arg[32];
+			char falloff_arg[32];
+			char default_arg[32];
+			sprintf(distance_arg, "%.17g", options.distance_settings.max_distance);
+			sprintf(falloff_arg, "%.17g", options.distance_settings.falloff);
+			sprintf(default_arg, "%.17g", options.distance_settings.default_value);
+			command.push_back("--max-distance");
+			command.push_back(distance_arg);
+			command.push_back("--falloff");
+			command.push_back(falloff_arg);
+			command.push_back("--default-value");
+			command.push_back(default_arg);
+			if(options.distance_settings.keep_existing)
+				command.push_back("--keep-existing");
+		}
+		// the workers read the same destination attributes
+		if(!options.attributes.empty())
+		{
+			std::string attribute_list;
+			for(unsigned i = 0; i < options.attributes.size(); i++)
+				attribute_list += (i > 0 ? "," : "") + options.attributes[i];
+			command.push_back("--attribute");
+			command.push_back(attribute_list);
+		}
+		command.push_back("--weights-out");
+		command.push_back(shard_path);
+		command.push_back(source_path);
+		command.push_back(options.dest_path);
+		return command;
+	}
+
+	// Opens the shard weight files and checks they cover the destination, returns false on failure.
+	bool open_shards(const std::vector<std::string>& shard_paths, unsigned vertex_count,
+					 unsigned channel_count, WeightFile* shards)
+	{
+		unsigned shard_count = (unsigned)shard_paths.size();
+		for(unsigned i = 0; i < shard_count; i++)
+		{
+			unsigned shard_start;
+			unsigned shard_size;
+			get_shard_range(vertex_count, shard_count, i, shard_start, shard_size);
+			if(!shards[i].open(shard_paths[i].c_str(), true))
+			{
+				fprintf(stderr, "%s\n", shards[i].get_error().c_str());
+				return false;
+			}
+			if(shards[i].get_vertex_count() != shard_size || shards[i].get_channel_count() != channel_count)
+			{
+				fprintf(stderr, "The shard does not match its destination range: %s\n", shard_paths[i].c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Writes the shard weights to the outputs in destination vertex order.
+	void merge_shards(const WeightFile* shards, unsigned channel_count,
+					  DestinationStream& dest, unsigned chunk_size)
+	{
+		std::vector<Point3d> positions(chunk_size);
+		std::vector<double> weights((size_t)chunk_size * WEIGHT_COUNT);
+		unsigned shard = 0;
+		unsigned shard_offset = 0;
+		unsigned count;
+		while((count = dest.read_positions(&positions[0], chunk_size)) > 0)
+		{
+			for(unsigned i = 0; i < count; i++)
+			{
+				while(shard_offset == shards[shard].get_vertex_count())
+				{
+					shard++;
+					shard_offset = 0;
+				}
+				// the stored channels are copied exactly
+				const double* shard_weights = shards[shard].get_weights();
+				expand_channels(&shard_weights[(size_t)shard_offset * channel_count], channel_count,
+								&weights[(size_t)i * WEIGHT_COUNT]);
+				shard_offset++;
+			}
+			dest.write_weights(&weights[0], count);
+		}
+	}
+
+	// Splits the destination into one shard per worker process.  The workers map the
+	// same built source file and write their shard to a weight file, then the shards
+	// are merged in vertex order.  Every vertex is sampled by the same code as in a
+	// single process, so the merged weights are identical to a single-process run.
+	int run_sharded_transfer(const CliOptions& options, const char* program, const SourceData& source)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<std::string> no_attributes;
+		MeshReader dest_reader;
+		if(!dest_reader.open(options.dest_path.c_str(), no_attributes))
+		{
+			fprintf(stderr, "%s\n", dest_reader.get_error().c_str());
+			return 1;
+		}
+
+		// the workers map a built source rather than building it again
+		std::vector<std::string> temporary_paths;
+		std::string source_path = options.source_path;
+		if(!has_extension(source_path, ".wts"))
+		{
+			source_path = options.save_source_path;
+			if(source_path.empty())
+			{
+				source_path = get_temporary_path(options, ".source.wts");
+				temporary_paths.push_back(source_path);
+				SourceFile saver;
+				if(!saver.save(source_path.c_str(), *source.surface))
+				{
+					fprintf(stderr, "%s\n", saver.get_error().c_str());
+					return 1;
+				}
+			}
+		}
+
+		std::vector<std::string> shard_paths;
+		std::vector<std::vector<std::string> > commands;
+		for(unsigned i = 0; i < options.process_count; i++)
+		{
+			char suffix[32];
+			sprintf(suffix, ".shard%u.wtw", i);
+			shard_paths.push_back(get_temporary_path(options, suffix));
+			temporary_paths.push_back(shard_paths.back());
+			commands.push_back(get_worker_command(options, program, source_path, i, shard_paths.back()));
+		}
+
+		// the worker output follows the output so far
+		fflush(stdout);
+		std::string error;
+		bool succeeded = run_processes(commands, error);
+		if(!succeeded)
+			fprintf(stderr, "%s\n", error.c_str());
+
+		unsigned vertex_count = dest_reader.get_vertex_count();
+		unsigned channel_count = source.surface->get_channel_count();
+		std::unique_ptr<WeightFile[]> shards(new WeightFile[options.process_count]);
+		OutputFiles outputs;
+		succeeded = succeeded &&
+					open_shards(shard_paths, vertex_count, channel_count, shards.get()) &&
+					open_outputs(options, dest_reader, vertex_count, channel_count, source.channel_names, outputs);
+		if(succeeded)
+		{
+			FileDestinationStream dest(dest_reader, outputs.write_mesh ? &outputs.writer : NULL,
+									   outputs.write_weight_file ? &outputs.weights : NULL);
+			merge_shards(shards.get(), channel_count, dest, get_chunk_size(options, dest_reader, vertex_count));
+			succeeded = close_outputs(dest_reader, outputs);
+		}
+
+		shards.reset();
+		for(unsigned i = 0; i < temporary_paths.size(); i++)
+			remove(temporary_paths[i].c_str());
+		if(!succeeded)
+			return 1;
+
+		printf("Merged %u vertices from %u worker processes in %.3f s\n",
+			   vertex_count, options.process_count, seconds_since(start));
+		return 0;
+	}
+}
+
+// command-line weight transfer entry function
+int main(int argc, char** argv)
+{
+	CliOptions options;
+	if(!parse_arguments(argc, argv, options))
+	{
+		print_usage();
+		return 1;
+	}
+
+	// saved operators are applied without building the source
+	if(!options.operator_paths.empty())
+		return run_operator(options);
+
+	SourceData source;
+	if(!load_source(options, source))
+		return 1;
+	if(!options.operator_out_path.empty())
+		return run_operator_build(options, source);
+	if(options.mirror)
+		return run_mirror(options, source);
+	if(options.process_count > 1)
+		return run_sharded_transfer(options, argv[0], source);
+	return run_transfer(options, source);
+}
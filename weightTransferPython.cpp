@@ -0,0 +1,1005 @@
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <weightedSurface.h>
+#include <weightStream.h>
+#include <sourceFile.h>
+#include <weightOperator.h>
+#include <systemInfo.h>
+
+using namespace WeightTransferTool;
+
+namespace
+{
+	// This class holds a buffer exported by a Python object, such as a NumPy
+	// array, and releases it when it goes out of scope.  The data is used in
+	// place, it is never copied.
+	class BufferView
+	{
+		public:
+			BufferView() : held(false) {};			// BufferView class constructor.
+			~BufferView()							// BufferView class deconstructor.
+			{
+				release();
+			}
+
+			// Gets the C-contiguous buffer of an object, writable if asked, and
+			// raises a TypeError if the object has none.
+			bool get(PyObject* object, bool writable, const char* name)
+			{
+				release();
+				int flags = PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0);
+				if(PyObject_GetBuffer(object, &view, flags) != 0)
+				{
+					PyErr_Format(PyExc_TypeError, "%s must be a C-contiguous%s array", name,
+								 writable ? " writable" : "");
+					return false;
+				}
+				held = true;
+				return true;
+			}
+
+			// Releases the buffer if one is held.
+			void release()
+			{
+				if(held)
+					PyBuffer_Release(&view);
+				held = false;
+			}
+
+			// Returns the buffer's item format without its native byte order prefix.
+			const char* get_format() const
+			{
+				const char* format = view.format != NULL ? view.format : "B";
+				const unsigned one = 1;
+				bool little_endian = *(const unsigned char*)&one == 1;
+				if(*format == '@' || *format == '=' || (*format == '<' && little_endian))
+					format++;
+				return format;
+			}
+
+			// Returns true if the buffer holds doubles.
+			bool is_double() const
+			{
+				return strcmp(get_format(), "d") == 0 && view.itemsize == sizeof(double);
+			}
+
+			// Returns true if the buffer holds 4 or 8 byte integers.
+			bool is_integer() const
+			{
+				const char* format = get_format();
+				return format[0] != '\0' && format[1] == '\0' && strchr("ilqnILQN", format[0]) != NULL &&
+					   (view.itemsize == 4 || view.itemsize == 8);
+			}
+
+			// Returns the number of items in the buffer.
+			size_t get_count() const
+			{
+				return view.itemsize > 0 ? (size_t)(view.len / view.itemsize) : 0;
+			}
+
+			// Returns the number of columns of a one or two dimensional buffer, zero for others.
+			size_t get_columns() const
+			{
+				if(view.ndim <= 1)
+					return 1;
+				return view.ndim == 2 ? (size_t)view.shape[1] : 0;
+			}
+
+			// Returns the integer at an index, which must be in range.
+			long long get_integer(size_t index) const
+			{
+				const char* format = get_format();
+				bool is_unsigned = format[0] >= 'A' && format[0] <= 'Z';
+				if(view.itemsize == 4)
+					return is_unsigned ? (long long)((const unsigned*)view.buf)[index] :
+										 (long long)((const int*)view.buf)[index];
+				return ((const long long*)view.buf)[index];
+			}
+
+			Py_buffer view;							// The exported buffer.
+			bool held;								// Indicates the buffer is held.
+	};
+
+	// The sampled source of a Python Source object, either built from arrays or mapped from a built source file.
+	struct PythonSource
+	{
+		WeightedSurface built;					// The surface built from arrays.
+		SourceFile mapped;						// The mapped built source file.
+		const WeightedSurface* surface;			// The surface which is sampled, NULL until built.
+		BufferView weight_buffer;				// The source weights, sampled in place.
+		bool flat_weights;						// Indicates sampled weights are returned as one dimensional arrays.
+		unsigned sampling_count;				// The number of samples in progress with the GIL released.
+	};
+
+	// The Python Source object.
+	struct SourceObject
+	{
+		PyObject_HEAD
+		PythonSource* source;					// The sampled source.
+	};
+
+	// the Python Source type, zero-initialized and filled in when the module is created
+	PyTypeObject source_type;
+
+	// The Python Operator object.  Its operator is never changed once made,
+	// so it is applied and composed with the GIL released.
+	struct OperatorObject
+	{
+		PyObject_HEAD
+		WeightOperator* transfer_operator;		// The operator, built or mapped from a file.
+	};
+
+	// the Python Operator type, zero-initialized and filled in when the module is created
+	PyTypeObject operator_type;
+
+	// Returns the source of an object, or raises a RuntimeError if it has not been built.
+	PythonSource* get_built_source(PyObject* self)
+	{
+		PythonSource* source = ((SourceObject*)self)->source;
+		if(source == NULL || source->surface == NULL)
+		{
+			PyErr_SetString(PyExc_RuntimeError, "The source has not been built.");
+			return NULL;
+		}
+		return source;
+	}
+
+	// Returns the number of threads asked for, all hardware threads for zero.
+	unsigned get_thread_count(unsigned thread_count)
+	{
+		return thread_count > 0 ? thread_count : get_processor_count();
+	}
+
+	// This stream reads destination positions from a buffer of points and writes the
+	// sampled weights straight into an output buffer.  Only one chunk of positions is
+	// copied at a time, into the working array of the transfer.
+	class BufferDestinationStream : public DestinationStream
+	{
+		public:
+			BufferDestinationStream(const double* new_points, size_t new_count, double* new_out,
+									const double* new_existing, unsigned new_channel_count)
+				: points(new_points), point_count(new_count), out(new_out), existing(new_existing),
+				  channel_count(new_channel_count), read_index(0), write_index(0) {};
+			~BufferDestinationStream(){};
+
+			// Reads the next chunk of points.
+			unsigned read_positions(Point3d* positions, unsigned max_count)
+			{
+				unsigned count = (unsigned)std::min((size_t)max_count, point_count - read_index);
+				for(unsigned i = 0; i < count; i++)
+				{
+					const double* point = &points[(read_index + i) * 3];
+					positions[i].x = point[0];
+					positions[i].y = point[1];
+					positions[i].z = point[2];
+				}
+				read_index += count;
+				return count;
+			}
+
+			// Writes the channels of the weights of the last chunk to the output.
+			void write_weights(const double* weights, unsigned count)
+			{
+				for(unsigned i = 0; i < count; i++)
+					memcpy(&out[(write_index + i) * channel_count], &weights[i * WEIGHT_COUNT],
+						   sizeof(double) * channel_count);
+				write_index += count;
+			}
+
+			// Reads the existing weights of the last chunk, if any were given.
+			bool read_existing_weights(double* weights, unsigned count)
+			{
+				if(existing == NULL)
+					return false;
+				for(unsigned i = 0; i < count; i++)
+					expand_channels(&existing[(write_index + i) * channel_count], channel_count,
+									&weights[i * WEIGHT_COUNT]);
+				return true;
+			}
+
+		private:
+			const double* points;					// Three coordinates for every destination point.
+			size_t point_count;						// The number of destination points.
+			double* out;							// channel_count output weights for every point.
+			const double* existing;					// channel_count existing weights for every point or NULL.
+			unsigned channel_count;					// The number of weight channels per point.
+			size_t read_index;						// The index of the next point to read.
+			size_t write_index;						// The index of the next point to write.
+	};
+
+	// Reads the positions of a buffer of points, three doubles per point, and
+	// returns the number of points.  Raises a ValueError if the shape is invalid.
+	bool get_points(PyObject* object, BufferView& buffer, const char* name, size_t& count)
+	{
+		if(!buffer.get(object, false, name))
+			return false;
+		if(!buffer.is_double() || (buffer.view.ndim != 1 && buffer.get_columns() != 3) ||
+		   buffer.get_count() % 3 != 0)
+		{
+			PyErr_Format(PyExc_ValueError, "%s must be a float64 array of shape (n, 3)", name);
+			return false;
+		}
+		count = buffer.get_count() / 3;
+		return true;
+	}
+
+	// Reads an integer array into a vector.  Raises a ValueError if it does not hold integers.
+	bool get_integers(PyObject* object, const char* name, std::vector<int>& values)
+	{
+		BufferView buffer;
+		if(!buffer.get(object, false, name))
+			return false;
+		if(!buffer.is_integer())
+		{
+			PyErr_Format(PyExc_ValueError, "%s must be an int32 or int64 array", name);
+			return false;
+		}
+		values.resize(buffer.get_count());
+		for(size_t i = 0; i < values.size(); i++)
+		{
+			long long value = buffer.get_integer(i);
+			if(value < 0 || value > 0x7FFFFFFF)
+			{
+				PyErr_Format(PyExc_ValueError, "%s holds an invalid value", name);
+				return false;
+			}
+			values[i] = (int)value;
+		}
+		return true;
+	}
+
+	// Makes a new NumPy array of shape (rows,) when it is flat, or (rows, columns)
+	// otherwise, of the given type.  NumPy is only imported when an array is made.
+	PyObject* new_numpy_array(size_t rows, size_t columns, bool flat, const char* dtype)
+	{
+		PyObject* numpy = PyImport_ImportModule("numpy");
+		if(numpy == NULL)
+			return NULL;
+		PyObject* shape = flat ? Py_BuildValue("(n)", (Py_ssize_t)rows) :
+								 Py_BuildValue("(nn)", (Py_ssize_t)rows, (Py_ssize_t)columns);
+		PyObject* result = shape != NULL ? PyObject_CallMethod(numpy, "empty", "(Os)", shape, dtype) : NULL;
+		Py_XDECREF(shape);
+		Py_DECREF(numpy);
+		return result;
+	}
+
+	// Returns a new reference to the array results are written to, out when it is given
+	// or else a new float64 NumPy array, and gets its writable buffer.  Raises the given
+	// ValueError if out does not hold rows times columns doubles.
+	PyObject* get_output_array(PyObject* out_object, size_t rows, size_t columns, bool flat,
+							   BufferView& out, const char* shape_error)
+	{
+		PyObject* result;
+		if(out_object != Py_None)
+		{
+			Py_INCREF(out_object);
+			result = out_object;
+		}
+		else if((result = new_numpy_array(rows, columns, flat, "float64")) == NULL)
+			return NULL;
+		if(!out.get(result, true, "out"))
+		{
+			Py_DECREF(result);
+			return NULL;
+		}
+		if(!out.is_double() || out.get_count() != rows * columns)
+		{
+			out.release();
+			Py_DECREF(result);
+			PyErr_SetString(PyExc_ValueError, shape_error);
+			return NULL;
+		}
+		return result;
+	}
+
+	// Allocates a Source object with an empty source.
+	PyObject* source_new(PyTypeObject* type, PyObject*, PyObject*)
+	{
+		SourceObject* self = (SourceObject*)type->tp_alloc(type, 0);
+		if(self == NULL)
+			return NULL;
+		self->source = new(std::nothrow) PythonSource();
+		if(self->source == NULL)
+		{
+			Py_DECREF(self);
+			return PyErr_NoMemory();
+		}
+		self->source->surface = NULL;
+		self->source->flat_weights = false;
+		self->source->sampling_count = 0;
+		return (PyObject*)self;
+	}
+
+	// Frees a Source object and releases its weight buffer.
+	void source_dealloc(PyObject* self)
+	{
+		delete ((SourceObject*)self)->source;
+		Py_TYPE(self)->tp_free(self);
+	}
+
+	// Builds the source surface from vertex positions, the vertex count of every face, the
+	// face vertex indexes and the vertex weights.  The positions are copied into the surface
+	// while the weights are sampled in place from their buffer, which is held by the source.
+	// The surface is built over the given number of threads with the GIL released.
+	int source_init(PyObject* self, PyObject* args, PyObject* kwds)
+	{
+		static const char* keywords[] = {"positions", "face_counts", "face_vertices", "weights", "threads", NULL};
+		PyObject* positions_object;
+		PyObject* face_counts_object;
+		PyObject* face_vertices_object;
+		PyObject* weights_object;
+		unsigned thread_count = 0;
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "OOOO|I", (char**)keywords, &positions_object,
+										&face_counts_object, &face_vertices_object, &weights_object,
+										&thread_count))
+			return -1;
+
+		PythonSource* source = ((SourceObject*)self)->source;
+		if(source->sampling_count > 0)
+		{
+			PyErr_SetString(PyExc_RuntimeError, "The source cannot be rebuilt while it is being sampled.");
+			return -1;
+		}
+		source->surface = NULL;
+
+		BufferView positions;
+		size_t vertex_count;
+		if(!get_points(positions_object, positions, "positions", vertex_count))
+			return -1;
+		BufferView& weights = source->weight_buffer;
+		if(!weights.get(weights_object, false, "weights"))
+			return -1;
+		size_t channel_count = weights.get_columns();
+		if(!weights.is_double() || channel_count < 1 || channel_count > WEIGHT_COUNT ||
+		   weights.get_count() != vertex_count * channel_count)
+		{
+			weights.release();
+			PyErr_SetString(PyExc_ValueError, "weights must be a float64 array of shape (n,) or (n, c) "
+							"with one to four channels for every position");
+			return -1;
+		}
+		source->flat_weights = weights.view.ndim <= 1;
+
+		// faces are split into fans of triangles like the mesh files
+		std::vector<int> face_counts;
+		std::vector<int> face_vertices;
+		if(!get_integers(face_counts_object, "face_counts", face_counts) ||
+		   !get_integers(face_vertices_object, "face_vertices", face_vertices))
+			return -1;
+		std::vector<int> tri_counts(face_counts.size());
+		std::vector<int> tri_verts;
+		size_t first = 0;
+		for(size_t f = 0; f < face_counts.size(); f++)
+		{
+			size_t face_size = (size_t)face_counts[f];
+			if(first + face_size > face_vertices.size())
+			{
+				PyErr_SetString(PyExc_ValueError, "face_counts adds up to more than the face_vertices");
+				return -1;
+			}
+			for(size_t i = 0; i < face_size; i++)
+			{
+				if((size_t)face_vertices[first + i] >= vertex_count)
+				{
+					PyErr_SetString(PyExc_ValueError, "face_vertices holds an index beyond the positions");
+					return -1;
+				}
+			}
+			tri_counts[f] = face_size > 2 ? (int)face_size - 2 : 0;
+			for(int i = 0; i < tri_counts[f]; i++)
+			{
+				tri_verts.push_back(face_vertices[first]);
+				tri_verts.push_back(face_vertices[first + i + 1]);
+				tri_verts.push_back(face_vertices[first + i + 2]);
+			}
+			first += face_size;
+		}
+
+		bool failed = false;
+		const double* points = (const double*)positions.view.buf;
+		unsigned threads = get_thread_count(thread_count);
+		Py_BEGIN_ALLOW_THREADS
+		try
+		{
+			WeightedSurface& surface = source->built;
+			surface.set_vertex_count((unsigned)vertex_count, (unsigned)channel_count);
+			surface.set_weight_buffer((const double*)weights.view.buf, (unsigned)channel_count);
+			for(size_t i = 0; i < vertex_count; i++)
+			{
+				Point3d position;
+				position.x = points[i * 3];
+				position.y = points[i * 3 + 1];
+				position.z = points[i * 3 + 2];
+				surface.set_vertex((unsigned)i, position, NULL);
+			}
+			surface.set_polygons((unsigned)tri_counts.size(), tri_counts.data(), tri_verts.data(), threads);
+			surface.build_tree(threads);
+			surface.build_vertex_hash();
+		}
+		catch(const std::bad_alloc&)
+		{
+			failed = true;
+		}
+		Py_END_ALLOW_THREADS
+		if(failed)
+		{
+			PyErr_NoMemory();
+			return -1;
+		}
+		source->surface = &source->built;
+		return 0;
+	}
+
+	// Samples the source weights at the closest point to every point, and returns an array of
+	// shape (n, c) with the sampled weights, or (n,) when the source weights are one dimensional.
+	// The weights are written into out when it is given, otherwise into a new NumPy array.  With
+	// a maximum distance, points out of range take the default value, or their existing weights
+	// when they are given, and blend toward them over the falloff band.  The sampling runs over
+	// the given number of threads with the GIL released.
+	PyObject* source_sample(PyObject* self, PyObject* args, PyObject* kwds)
+	{
+		static const char* keywords[] = {"points", "out", "existing", "interpolation", "coherent", "max_distance",
+										 "falloff", "default_value", "threads", "chunk_size", NULL};
+		PyObject* points_object;
+		PyObject* out_object = Py_None;
+		PyObject* existing_object = Py_None;
+		const char* interpolation_name = "linear";
+		int coherent = 0;
+		DistanceSettings distance_settings = {-1.0, 0.0, false, 0.0};
+		unsigned thread_count = 0;
+		unsigned chunk_size = DEFAULT_CHUNK_SIZE;
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOspdddII", (char**)keywords, &points_object,
+										&out_object, &existing_object, &interpolation_name, &coherent,
+										&distance_settings.max_distance, &distance_settings.falloff,
+										&distance_settings.default_value, &thread_count, &chunk_size))
+			return NULL;
+
+		PythonSource* source = get_built_source(self);
+		if(source == NULL)
+			return NULL;
+		InterpolationMode interpolation;
+		if(!parse_interpolation_mode(interpolation_name, interpolation))
+		{
+			PyErr_SetString(PyExc_ValueError, "interpolation must be linear, nearest, max or smooth");
+			return NULL;
+		}
+		if(distance_settings.falloff < 0.0 || chunk_size == 0)
+		{
+			PyErr_SetString(PyExc_ValueError, "falloff must not be negative and chunk_size must be positive");
+			return NULL;
+		}
+		if(existing_object != Py_None && !is_distance_limited(distance_settings))
+		{
+			PyErr_SetString(PyExc_ValueError, "existing weights require a maximum distance");
+			return NULL;
+		}
+
+		BufferView points;
+		size_t point_count;
+		if(!get_points(points_object, points, "points", point_count))
+			return NULL;
+		size_t channel_count = source->surface->get_channel_count();
+
+		BufferView existing;
+		if(existing_object != Py_None)
+		{
+			if(!existing.get(existing_object, false, "existing"))
+				return NULL;
+			if(!existing.is_double() || existing.get_count() != point_count * channel_count)
+			{
+				PyErr_SetString(PyExc_ValueError, "existing must be a float64 array with the source "
+								"channels for every point");
+				return NULL;
+			}
+			distance_settings.keep_existing = true;
+		}
+
+		BufferView out;
+		PyObject* result = get_output_array(out_object, point_count, channel_count, source->flat_weights, out,
+											"out must be a float64 array with the source channels for every point");
+		if(result == NULL)
+			return NULL;
+
+		BufferDestinationStream dest((const double*)points.view.buf, point_count, (double*)out.view.buf,
+									 existing.held ? (const double*)existing.view.buf : NULL,
+									 (unsigned)channel_count);
+		unsigned threads = get_thread_count(thread_count);
+		bool failed = false;
+		// the source is not rebuilt or quantized while the GIL is released
+		source->sampling_count++;
+		Py_BEGIN_ALLOW_THREADS
+		try
+		{
+			stream_weights(*source->surface, dest, chunk_size, threads, coherent != 0, interpolation,
+						   distance_settings);
+		}
+		catch(const std::bad_alloc&)
+		{
+			failed = true;
+		}
+		Py_END_ALLOW_THREADS
+		source->sampling_count--;
+		if(failed)
+		{
+			Py_DECREF(result);
+			return PyErr_NoMemory();
+		}
+		return result;
+	}
+
+	// Makes an Operator object which takes ownership of an operator.
+	PyObject* new_operator_object(WeightOperator* transfer_operator)
+	{
+		OperatorObject* self = (OperatorObject*)operator_type.tp_alloc(&operator_type, 0);
+		if(self == NULL)
+		{
+			delete transfer_operator;
+			return NULL;
+		}
+		self->transfer_operator = transfer_operator;
+		return (PyObject*)self;
+	}
+
+	// Builds the operator which maps the source weights to the weights sample would return
+	// for every point, with the same search and settings.  Applying it to the source weights,
+	// or to any other values of the source vertices, gives their transfer without searching
+	// the source again.  Only linear transfers are held, so the interpolation cannot be max
+	// and points out of range take zero.  The points are searched with the GIL released.
+	PyObject* source_operator(PyObject* self, PyObject* args, PyObject* kwds)
+	{
+		static const char* keywords[] = {"points", "interpolation", "coherent", "max_distance", "falloff",
+										 "threads", "chunk_size", NULL};
+		PyObject* points_object;
+		const char* interpolation_name = "linear";
+		int coherent = 0;
+		DistanceSettings distance_settings = {-1.0, 0.0, false, 0.0};
+		unsigned thread_count = 0;
+		unsigned chunk_size = DEFAULT_CHUNK_SIZE;
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|spddII", (char**)keywords, &points_object,
+										&interpolation_name, &coherent, &distance_settings.max_distance,
+										&distance_settings.falloff, &thread_count, &chunk_size))
+			return NULL;
+
+		PythonSource* source = get_built_source(self);
+		if(source == NULL)
+			return NULL;
+		InterpolationMode interpolation;
+		if(!parse_interpolation_mode(interpolation_name, interpolation) ||
+		   !is_linear_transfer(interpolation, distance_settings))
+		{
+			PyErr_SetString(PyExc_ValueError, "interpolation must be linear, nearest or smooth for an operator");
+			return NULL;
+		}
+		if(distance_settings.falloff < 0.0 || chunk_size == 0)
+		{
+			PyErr_SetString(PyExc_ValueError, "falloff must not be negative and chunk_size must be positive");
+			return NULL;
+		}
+
+		BufferView points;
+		size_t point_count;
+		if(!get_points(points_object, points, "points", point_count))
+			return NULL;
+		WeightOperator* transfer_operator = new(std::nothrow) WeightOperator();
+		if(transfer_operator == NULL)
+			return PyErr_NoMemory();
+
+		// no weights are written to the stream
+		BufferDestinationStream dest((const double*)points.view.buf, point_count, NULL, NULL,
+									 source->surface->get_channel_count());
+		unsigned threads = get_thread_count(thread_count);
+		bool failed = false;
+		source->sampling_count++;
+		Py_BEGIN_ALLOW_THREADS
+		try
+		{
+			stream_operator(*source->surface, dest, chunk_size, threads, coherent != 0, interpolation,
+							distance_settings, *transfer_operator);
+		}
+		catch(const std::bad_alloc&)
+		{
+			failed = true;
+		}
+		Py_END_ALLOW_THREADS
+		source->sampling_count--;
+		if(failed)
+		{
+			delete transfer_operator;
+			return PyErr_NoMemory();
+		}
+		return new_operator_object(transfer_operator);
+	}
+
+	// Stores the source weights as 16-bit values and returns the largest quantization error.
+	PyObject* source_quantize(PyObject* self, PyObject*)
+	{
+		PythonSource* source = get_built_source(self);
+		if(source == NULL)
+			return NULL;
+		if(source->surface != &source->built || source->sampling_count > 0)
+		{
+			PyErr_SetString(PyExc_RuntimeError, "A mapped source, or one being sampled, cannot be quantized.");
+			return NULL;
+		}
+		double error = source->built.quantize_weights();
+		// the quantized weights are owned, so the weight buffer is no longer used
+		source->weight_buffer.release();
+		return PyFloat_FromDouble(error);
+	}
+
+	// Saves the built source surface to a .wts file.
+	PyObject* source_save(PyObject* self, PyObject* args)
+	{
+		const char* path;
+		if(!PyArg_ParseTuple(args, "s", &path))
+			return NULL;
+		PythonSource* source = get_built_source(self);
+		if(source == NULL)
+			return NULL;
+		SourceFile saver;
+		if(!saver.save(path, *source->surface))
+		{
+			PyErr_SetString(PyExc_IOError, saver.get_error().c_str());
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	// Returns the number of source vertices.
+	PyObject* source_get_vertex_count(PyObject* self, void*)
+	{
+		PythonSource* source = get_built_source(self);
+		return source != NULL ? PyLong_FromUnsignedLong(source->surface->get_vertex_count()) : NULL;
+	}
+
+	// Returns the number of source triangles.
+	PyObject* source_get_triangle_count(PyObject* self, void*)
+	{
+		PythonSource* source = get_built_source(self);
+		return source != NULL ? PyLong_FromUnsignedLong(source->surface->get_triangle_count()) : NULL;
+	}
+
+	// Returns the number of weight channels per source vertex.
+	PyObject* source_get_channel_count(PyObject* self, void*)
+	{
+		PythonSource* source = get_built_source(self);
+		return source != NULL ? PyLong_FromUnsignedLong(source->surface->get_channel_count()) : NULL;
+	}
+
+	// Frees an Operator object and its operator.
+	void operator_dealloc(PyObject* self)
+	{
+		delete ((OperatorObject*)self)->transfer_operator;
+		Py_TYPE(self)->tp_free(self);
+	}
+
+	// Applies the operator to values of the source vertices, an array of shape (n,) or (n, c)
+	// with any number of channels, and returns the transferred values for every destination
+	// point in an array of the same number of dimensions.  The values are written into out
+	// when it is given, otherwise into a new NumPy array.  The product runs over the given
+	// number of threads with the GIL released.
+	PyObject* operator_apply(PyObject* self, PyObject* args, PyObject* kwds)
+	{
+		static const char* keywords[] = {"values", "out", "threads", NULL};
+		PyObject* values_object;
+		PyObject* out_object = Py_None;
+		unsigned thread_count = 0;
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|OI", (char**)keywords, &values_object, &out_object,
+										&thread_count))
+			return NULL;
+
+		const WeightOperator* transfer_operator = ((OperatorObject*)self)->transfer_operator;
+		BufferView values;
+		if(!values.get(values_object, false, "values"))
+			return NULL;
+		size_t channel_count = values.get_columns();
+		if(!values.is_double() || channel_count == 0 ||
+		   values.get_count() != (size_t)transfer_operator->get_column_count() * channel_count)
+		{
+			PyErr_SetString(PyExc_ValueError, "values must be a float64 array of shape (n,) or (n, c) "
+							"with a row for every source vertex");
+			return NULL;
+		}
+
+		BufferView out;
+		PyObject* result = get_output_array(out_object, transfer_operator->get_row_count(), channel_count,
+											values.view.ndim <= 1, out, "out must be a float64 array with the "
+											"channels of the values for every destination point");
+		if(result == NULL)
+			return NULL;
+		const char* values_start = (const char*)values.view.buf;
+		const char* out_start = (const char*)out.view.buf;
+		if(out.view.len > 0 && values.view.len > 0 &&
+		   out_start < values_start + values.view.len && values_start < out_start + out.view.len)
+		{
+			Py_DECREF(result);
+			PyErr_SetString(PyExc_ValueError, "out must not overlap the values");
+			return NULL;
+		}
+
+		unsigned threads = get_thread_count(thread_count);
+		Py_BEGIN_ALLOW_THREADS
+		transfer_operator->apply((const double*)values.view.buf, (unsigned)channel_count, (double*)out.view.buf,
+								 threads);
+		Py_END_ALLOW_THREADS
+		return result;
+	}
+
+	// Returns the operator which applies this operator followed by the second, so a chain
+	// of transfers collapses into one.  Raises a ValueError if this operator's destination
+	// is not the second's source.  The operators are composed with the GIL released.
+	PyObject* operator_compose(PyObject* self, PyObject* args, PyObject* kwds)
+	{
+		static const char* keywords[] = {"second", "threads", NULL};
+		PyObject* second_object;
+		unsigned thread_count = 0;
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "O!|I", (char**)keywords, &operator_type, &second_object,
+										&thread_count))
+			return NULL;
+
+		const WeightOperator* first = ((OperatorObject*)self)->transfer_operator;
+		const WeightOperator* second = ((OperatorObject*)second_object)->transfer_operator;
+		WeightOperator* composed = new(std::nothrow) WeightOperator();
+		if(composed == NULL)
+			return PyErr_NoMemory();
+		unsigned threads = get_thread_count(thread_count);
+		bool composed_rows = false;
+		bool failed = false;
+		Py_BEGIN_ALLOW_THREADS
+		try
+		{
+			composed_rows = composed->compose(*first, *second, threads);
+		}
+		catch(const std::bad_alloc&)
+		{
+			failed = true;
+		}
+		Py_END_ALLOW_THREADS
+		if(failed || !composed_rows)
+		{
+			if(failed)
+				PyErr_NoMemory();
+			else
+				PyErr_SetString(PyExc_ValueError, composed->get_error().c_str());
+			delete composed;
+			return NULL;
+		}
+		return new_operator_object(composed);
+	}
+
+	// Saves the operator to a .wto file.
+	PyObject* operator_save(PyObject* self, PyObject* args)
+	{
+		const char* path;
+		if(!PyArg_ParseTuple(args, "s", &path))
+			return NULL;
+		WeightOperator* transfer_operator = ((OperatorObject*)self)->transfer_operator;
+		if(!transfer_operator->save(path))
+		{
+			PyErr_SetString(PyExc_IOError, transfer_operator->get_error().c_str());
+			return NULL;
+		}
+		Py_RETURN_NONE;
+	}
+
+	// Copies an array of the operator into a new one dimensional NumPy array of the given type.
+	PyObject* copy_operator_array(const void* data, size_t count, size_t item_size, const char* dtype)
+	{
+		PyObject* result = new_numpy_array(count, 1, true, dtype);
+		if(result == NULL)
+			return NULL;
+		BufferView buffer;
+		if(!buffer.get(result, true, "array"))
+		{
+			Py_DECREF(result);
+			return NULL;
+		}
+		if(count > 0)
+			memcpy(buffer.view.buf, data, count * item_size);
+		return result;
+	}
+
+	// Returns copies of the row offsets, column indexes and coefficients of the operator, the
+	// indptr, indices and data arrays of a compressed sparse row matrix.
+	PyObject* operator_arrays(PyObject* self, PyObject*)
+	{
+		const WeightOperator* transfer_operator = ((OperatorObject*)self)->transfer_operator;
+		size_t entry_count = transfer_operator->get_entry_count();
+		PyObject* row_offsets = copy_operator_array(transfer_operator->get_row_offsets(),
+													(size_t)transfer_operator->get_row_count() + 1,
+													sizeof(unsigned long long), "uint64");
+		PyObject* columns = row_offsets != NULL ? copy_operator_array(transfer_operator->get_columns(), entry_count,
+																	  sizeof(unsigned), "uint32") : NULL;
+		PyObject* coefficients = columns != NULL ? copy_operator_array(transfer_operator->get_coefficients(),
+																	   entry_count, sizeof(double), "float64") : NULL;
+		if(coefficients == NULL)
+		{
+			Py_XDECREF(row_offsets);
+			Py_XDECREF(columns);
+			return NULL;
+		}
+		return Py_BuildValue("(NNN)", row_offsets, columns, coefficients);
+	}
+
+	// Returns the number of destination points, the rows of the operator.
+	PyObject* operator_get_row_count(PyObject* self, void*)
+	{
+		return PyLong_FromUnsignedLong(((OperatorObject*)self)->transfer_operator->get_row_count());
+	}
+
+	// Returns the number of source vertices, the columns of the operator.
+	PyObject* operator_get_column_count(PyObject* self, void*)
+	{
+		return PyLong_FromUnsignedLong(((OperatorObject*)self)->transfer_operator->get_column_count());
+	}
+
+	// Returns the number of non-zero coefficients of the operator.
+	PyObject* operator_get_entry_count(PyObject* self, void*)
+	{
+		return PyLong_FromSize_t(((OperatorObject*)self)->transfer_operator->get_entry_count());
+	}
+
+	// Maps an operator file saved by Operator.save or the command-line tool's --operator-out.
+	PyObject* load_operator(PyObject*, PyObject* args)
+	{
+		const char* path;
+		if(!PyArg_ParseTuple(args, "s", &path))
+			return NULL;
+		WeightOperator* transfer_operator = new(std::nothrow) WeightOperator();
+		if(transfer_operator == NULL)
+			return PyErr_NoMemory();
+		if(!transfer_operator->open(path))
+		{
+			PyErr_SetString(PyExc_IOError, transfer_operator->get_error().c_str());
+			delete transfer_operator;
+			return NULL;
+		}
+		return new_operator_object(transfer_operator);
+	}
+
+	// Maps a built source file saved by Source.save or the command-line tool's --save-source.
+	PyObject* load_source(PyObject*, PyObject* args)
+	{
+		const char* path;
+		if(!PyArg_ParseTuple(args, "s", &path))
+			return NULL;
+		PyObject* self = source_new(&source_type, NULL, NULL);
+		if(self == NULL)
+			return NULL;
+		PythonSource* source = ((SourceObject*)self)->source;
+		if(!source->mapped.open(path))
+		{
+			PyErr_SetString(PyExc_IOError, source->mapped.get_error().c_str());
+			Py_DECREF(self);
+			return NULL;
+		}
+		source->surface = &source->mapped.get_surface();
+		source->flat_weights = source->surface->get_channel_count() == 1;
+		return self;
+	}
+
+	PyMethodDef source_methods[] =
+	{
+		{"sample", (PyCFunction)(void(*)(void))source_sample, METH_VARARGS | METH_KEYWORDS,
+		 "sample(points, out=None, existing=None, interpolation='linear', coherent=False, max_distance=-1.0,\n"
+		 "       falloff=0.0, default_value=0.0, threads=0, chunk_size=65536)\n"
+		 "Samples the weights at the closest source point to every point.  With coherent=True the search walks\n"
+		 "from the previous point's triangle and can return a different surface point than the exact search."},
+		{"operator", (PyCFunction)(void(*)(void))source_operator, METH_VARARGS | METH_KEYWORDS,
+		 "operator(points, interpolation='linear', coherent=False, max_distance=-1.0, falloff=0.0,\n"
+		 "         threads=0, chunk_size=65536)\n"
+		 "Builds the sparse operator which maps source vertex values to the sampled values of every point."},
+		{"quantize", (PyCFunction)source_quantize, METH_NOARGS,
+		 "Stores the weights as 16-bit values and returns the largest error."},
+		{"save", (PyCFunction)source_save, METH_VARARGS, "Saves the built source to a .wts file."},
+		{NULL, NULL, 0, NULL}
+	};
+
+	PyGetSetDef source_getters[] =
+	{
+		{(char*)"vertex_count", source_get_vertex_count, NULL, (char*)"The number of source vertices.", NULL},
+		{(char*)"triangle_count", source_get_triangle_count, NULL, (char*)"The number of source triangles.", NULL},
+		{(char*)"channel_count", source_get_channel_count, NULL, (char*)"The weight channels per vertex.", NULL},
+		{NULL, NULL, NULL, NULL, NULL}
+	};
+
+	PyMethodDef operator_methods[] =
+	{
+		{"apply", (PyCFunction)(void(*)(void))operator_apply, METH_VARARGS | METH_KEYWORDS,
+		 "apply(values, out=None, threads=0)\n"
+		 "Transfers values of the source vertices, of shape (n,) or (n, c), to the destination points."},
+		{"compose", (PyCFunction)(void(*)(void))operator_compose, METH_VARARGS | METH_KEYWORDS,
+		 "compose(second, threads=0)\n"
+		 "Returns the operator which applies this operator and then the second."},
+		{"save", (PyCFunction)operator_save, METH_VARARGS, "Saves the operator to a .wto file."},
+		{"arrays", (PyCFunction)operator_arrays, METH_NOARGS,
+		 "Returns copies of the indptr, indices and data arrays of the operator's CSR matrix."},
+		{NULL, NULL, 0, NULL}
+	};
+
+	PyGetSetDef operator_getters[] =
+	{
+		{(char*)"row_count", operator_get_row_count, NULL, (char*)"The number of destination points.", NULL},
+		{(char*)"column_count", operator_get_column_count, NULL, (char*)"The number of source vertices.", NULL},
+		{(char*)"entry_count", operator_get_entry_count, NULL, (char*)"The number of non-zero coefficients.", NULL},
+		{NULL, NULL, NULL, NULL, NULL}
+	};
+
+	PyMethodDef module_methods[] =
+	{
+		{"load_source", load_source, METH_VARARGS, "Maps a built .wts source file."},
+		{"load_operator", load_operator, METH_VARARGS, "Maps a .wto operator file."},
+		{NULL, NULL, 0, NULL}
+	};
+
+	PyModuleDef module_definition =
+	{
+		PyModuleDef_HEAD_INIT,
+		"weightTransferPython",
+		"Samples vertex weights at the closest point on a source mesh.",
+		-1,
+		module_methods,
+		NULL,									// m_slots
+		NULL,									// m_traverse
+		NULL,									// m_clear
+		NULL									// m_free
+	};
+}
+
+// intialize the weightTransferPython module
+PyMODINIT_FUNC PyInit_weightTransferPython()
+{
+	// only the object header of the static types is set, the other fields start out zero
+	PyVarObject type_head = {PyObject_HEAD_INIT(NULL) 0};
+	source_type.ob_base = type_head;
+	source_type.tp_name = "weightTransferPython.Source";
+	source_type.tp_basicsize = sizeof(SourceObject);
+	source_type.tp_flags = Py_TPFLAGS_DEFAULT;
+	source_type.tp_doc = "Source(positions, face_counts, face_vertices, weights, threads=0)\n"
+						 "A source mesh whose weights are sampled at the closest point to other points.";
+	source_type.tp_new = source_new;
+	source_type.tp_init = source_init;
+	source_type.tp_dealloc = source_dealloc;
+	source_type.tp_methods = source_methods;
+	source_type.tp_getset = source_getters;
+	if(PyType_Ready(&source_type) < 0)
+		return NULL;
+	operator_type.ob_base = type_head;
+	operator_type.tp_name = "weightTransferPython.Operator";
+	operator_type.tp_basicsize = sizeof(OperatorObject);
+	operator_type.tp_flags = Py_TPFLAGS_DEFAULT;
+	operator_type.tp_doc = "A transfer from source vertices to destination points as a sparse matrix, made by\n"
+						   "Source.operator, Operator.compose or load_operator.";
+	operator_type.tp_dealloc = operator_dealloc;
+	operator_type.tp_methods = operator_methods;
+	operator_type.tp_getset = operator_getters;
+	if(PyType_Ready(&operator_type) < 0)
+		return NULL;
+
+	PyObject* module = PyModule_Create(&module_definition);
+	if(module == NULL)
+		return NULL;
+	Py_INCREF(&source_type);
+	if(PyModule_AddObject(module, "Source", (PyObject*)&source_type) < 0)
+	{
+		Py_DECREF(&source_type);
+		Py_DECREF(module);
+		return NULL;
+	}
+	Py_INCREF(&operator_type);
+	if(PyModule_AddObject(module, "Operator", (PyObject*)&operator_type) < 0)
+	{
+		Py_DECREF(&operator_type);
+		Py_DECREF(module);
+		return NULL;
+	}
+	return module;
+}
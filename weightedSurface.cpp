@@ -0,0 +1,1255 @@
+
+#include <algorithm>
+#include <float.h>
+#include <thread>
+
+#include <weightedSurface.h>
+#include <taskScheduler.h>
+
+namespace WeightTransferTool
+{
+	// Tests two 2D points to see if the line segment they define crosses the positive X-axis.
+	bool edge_crosses_x_axis(const Point2d& p0, const Point2d& p1)
+	{
+		if(p0.y == 0.0 && p1.y == 0.0)
+			// The edge is on the X-axis, count this as an intersection
+			// as long as the segment is partially positive.
+			return p0.x > 0 || p1.x > 0;
+		if(simple_sign(p0.y) == simple_sign(p1.y))
+			// Both end points are on the same side of the X-axis,
+			// so the edge cannot cross it.
+			return false;
+		if(simple_sign(p0.x) && simple_sign(p1.x))
+			// Both end points are to the right of the Y-axis but opposite 
+			// sides of the X-axis. A positive intersection must occur.
+			return true;
+		if(!simple_sign(p0.x) && !simple_sign(p1.x))
+			// Both end points are to the left of the Y-axis.
+			// No intersection with the positive X-axis is possible.
+			return false;
+
+		// The edge crosses the X-axis.
+		// Calculate the x-intercept.
+		//
+		double inv_slope = (p1.x - p0.x) / (p1.y - p0.y);
+		double x_int = p0.x - inv_slope * p0.y;
+
+		// check for positive value
+		return simple_sign(x_int);
+	}
+
+	// Returns true if the number is greater than or equal to zero, false otherwise.
+	bool simple_sign(double number)
+	{
+		return number >= 0;
+	}
+
+	// Expands the channels of an attribute value into WEIGHT_COUNT weights.
+	void expand_channels(const double* values, unsigned channel_count, double* out_weights)
+	{
+		if(channel_count == 1)
+		{
+			// a single value fills every weight like a doubleArray attribute
+			double value = values[0];
+			for(unsigned i = 0; i < WEIGHT_COUNT; i++)
+				out_weights[i] = value;
+			return;
+		}
+		for(unsigned i = 0; i < WEIGHT_COUNT; i++)
+			out_weights[i] = i < channel_count ? values[i] : 0.0;
+	}
+
+	// The per-triangle layout used before triangles referenced their vertices
+	// by index.  It is only used to report the footprint of the previous layout.
+	struct LegacyTriangleLayout
+	{
+		void* vertices[3];
+		double centroid[4];
+		double normal[3];
+		MajorAxis major_axis;
+		double area_times_2;
+		Point2d projected[3];
+	};
+
+	// Two triangle records must fit in one 64 byte cache line.
+	static_assert(sizeof(WeightedTriangle) == 32, "WeightedTriangle must stay 32 bytes");
+
+	// Returns the difference of two points as a vector.
+	static inline Point3d subtract(const Point3d& p0, const Point3d& p1)
+	{
+		Point3d delta = {p0.x - p1.x, p0.y - p1.y, p0.z - p1.z};
+		return delta;
+	}
+
+	// Returns the cross product of two vectors.
+	static inline Point3d cross(const Point3d& a, const Point3d& b)
+	{
+		Point3d result = {a.y * b.z - a.z * b.y,
+						  a.z * b.x - a.x * b.z,
+						  a.x * b.y - a.y * b.x};
+		return result;
+	}
+
+	// Returns the length of a vector.
+	static inline double length(const Point3d& v)
+	{
+		return sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+	}
+
+	// Returns the squared distance between two points.
+	static inline double get_distance_sq(const Point3d& p0, const Point3d& p1)
+	{
+		Point3d delta = subtract(p0, p1);
+		return delta.x * delta.x + delta.y * delta.y + delta.z * delta.z;
+	}
+
+	// WeightedSurface class constructor.
+	WeightedSurface::WeightedSurface()
+	{
+		vertex_count = 0;
+		polygon_count = 0;
+		triangle_count = 0;
+		poly_vert_count = 0;
+		channel_count = WEIGHT_COUNT;
+		positions = NULL;
+		weights = NULL;
+		quantized_weights = NULL;
+		tris = NULL;
+		polys = NULL;
+		poly_verts = NULL;
+		built_face_count.store(0);
+		memset(weight_scale, 0, sizeof(weight_scale));
+		memset(weight_offset, 0, sizeof(weight_offset));
+	}
+
+	// Allocates the vertex position and weight arrays for
+	// the given number of weight channels per vertex.
+	void WeightedSurface::set_vertex_count(unsigned new_vertex_count, unsigned new_channel_count)
+	{
+		vertex_count = new_vertex_count;
+		channel_count = new_channel_count;
+		owned_positions.resize(vertex_count);
+		owned_weights.resize((size_t)vertex_count * channel_count);
+		positions = owned_positions.data();
+		weights = owned_weights.data();
+		quantized_weights = NULL;
+		std::vector<unsigned short>().swap(owned_quantized_weights);
+	}
+
+	// Samples weights from an external buffer instead of the owned weights.
+	void WeightedSurface::set_weight_buffer(const double* buffer, unsigned new_channel_count)
+	{
+		channel_count = new_channel_count;
+		weights = buffer;
+		std::vector<double>().swap(owned_weights);
+		quantized_weights = NULL;
+		std::vector<unsigned short>().swap(owned_quantized_weights);
+	}
+
+	// Assigns a vertex position and weights.  The weights are
+	// skipped when they are NULL or in an external buffer.
+	void WeightedSurface::set_vertex(unsigned index, const Point3d& position,
+									 const double* new_weights)
+	{
+		owned_positions[index] = position;
+		if(new_weights != NULL && !owned_weights.empty())
+			memcpy(&owned_weights[(size_t)index * channel_count], new_weights, sizeof(double) * channel_count);
+	}
+
+	// the largest polygon, in triangles, whose unique vertices are found by scanning
+	static const unsigned MAX_SCANNED_TRIANGLES = 8;
+
+	// Lists the unique vertex indexes of a polygon's triangle corners in the order
+	// they are first used and returns their number.  The corners of large polygons
+	// are sorted rather than scanned, so n-gons with many triangles are not quadratic.
+	// Every corner is read before its place is written, so the list can replace the corners.
+	static unsigned list_polygon_vertices(const unsigned* corners, unsigned corner_count,
+										  std::vector<std::pair<unsigned, unsigned> >& sorted,
+										  unsigned* out_verts)
+	{
+		unsigned count = 0;
+		if(corner_count <= MAX_SCANNED_TRIANGLES * 3)
+		{
+			for(unsigned i = 0; i < corner_count; i++)
+			{
+				unsigned j = 0;
+				while(j < count && out_verts[j] != corners[i])
+					j++;
+				if(j == count)
+					out_verts[count++] = corners[i];
+			}
+			return count;
+		}
+
+		// sorted by vertex and then corner, the first use of every vertex leads its run
+		sorted.resize(corner_count);
+		for(unsigned i = 0; i < corner_count; i++)
+			sorted[i] = std::make_pair(corners[i], i);
+		std::sort(sorted.begin(), sorted.end());
+		unsigned previous = 0;
+		for(unsigned i = 0; i < corner_count; i++)
+		{
+			unsigned vertex = sorted[i].first;
+			if(i == 0 || vertex != previous)
+				sorted[count++] = std::make_pair(sorted[i].second, vertex);
+			previous = vertex;
+		}
+		// the first uses are put back in corner order
+		std::sort(sorted.begin(), sorted.begin() + count);
+		for(unsigned i = 0; i < count; i++)
+			out_verts[i] = sorted[i].second;
+		return count;
+	}
+
+	// the build states of a face whose data is built on demand
+	enum FaceState
+	{
+		FACE_PENDING = 0,						// The face's data has not been built.
+		FACE_BUILDING = 1,						// A thread is building the face's data.
+		FACE_BUILT = 2,							// The face's data is ready to be sampled.
+	};
+
+	// Builds the triangle and polygon arrays from the number of triangles in
+	// each polygon and the triangle vertex indexes, spread over the given number
+	// of threads.  Only the data the search needs is set up front: the polygons'
+	// first triangles, a prefix sum of their triangle counts, and the corners of
+	// every triangle.  The planes of a polygon's triangles and its unique vertex
+	// list are built the first time a sample lands on it, so a destination which
+	// only covers part of a large source only pays for the faces it touches.
+	// Every polygon's vertex list has room for its triangle count plus two
+	// vertices, the corners of a polygon triangulated without added points.
+	void WeightedSurface::set_polygons(unsigned new_polygon_count,
+									   const int* tri_counts,
+									   const int* tri_vert_indexes,
+									   unsigned thread_count)
+	{
+		polygon_count = new_polygon_count;
+		owned_polys.resize(polygon_count + 1);
+		triangle_count = 0;
+		poly_vert_count = 0;
+		for(unsigned i = 0; i < polygon_count; i++)
+		{
+			owned_polys[i].first_triangle = triangle_count;
+			owned_polys[i].first_vertex = poly_vert_count;
+			triangle_count += tri_counts[i];
+			if(tri_counts[i] > 0)
+				poly_vert_count += tri_counts[i] + 2;
+		}
+		owned_polys[polygon_count].first_triangle = triangle_count;
+		owned_polys[polygon_count].first_vertex = poly_vert_count;
+		owned_tris.resize(triangle_count);
+		owned_poly_verts.resize(poly_vert_count);
+
+		parallel_for(triangle_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			for(unsigned i = start; i < end; i++)
+			{
+				owned_tris[i].v0 = (unsigned)tri_vert_indexes[(size_t)i * 3];
+				owned_tris[i].v1 = (unsigned)tri_vert_indexes[(size_t)i * 3 + 1];
+				owned_tris[i].v2 = (unsigned)tri_vert_indexes[(size_t)i * 3 + 2];
+			}
+		});
+		face_states.reset(new std::atomic<unsigned char>[polygon_count]);
+		for(unsigned i = 0; i < polygon_count; i++)
+			face_states[i].store(FACE_PENDING, std::memory_order_relaxed);
+		built_face_count.store(0, std::memory_order_relaxed);
+
+		tris = owned_tris.data();
+		polys = owned_polys.data();
+		poly_verts = owned_poly_verts.data();
+	}
+
+	// Builds the planes of a polygon's triangles and its unique vertex list.  A polygon
+	// with repeated corners or holes has fewer vertices than its list has room for,
+	// and the rest of its list is padded with NO_VERTEX.
+	void WeightedSurface::build_face(unsigned face_index) const
+	{
+		unsigned start = polys[face_index].first_triangle;
+		unsigned end = polys[face_index + 1].first_triangle;
+		unsigned corners_stack[MAX_SCANNED_TRIANGLES * 3];
+		std::vector<unsigned> corners_heap;
+		unsigned* corners = corners_stack;
+		if(end - start > MAX_SCANNED_TRIANGLES)
+		{
+			corners_heap.resize((size_t)(end - start) * 3);
+			corners = corners_heap.data();
+		}
+		for(unsigned i = start; i < end; i++)
+		{
+			owned_tris[i].set_plane(positions);
+			corners[(i - start) * 3] = tris[i].v0;
+			corners[(i - start) * 3 + 1] = tris[i].v1;
+			corners[(i - start) * 3 + 2] = tris[i].v2;
+		}
+
+		// the vertices are listed over the corners, which are read before they are overwritten,
+		// and only copied to the polygon's list as far as it has room
+		std::vector<std::pair<unsigned, unsigned> > sorted;
+		unsigned count = list_polygon_vertices(corners, (end - start) * 3, sorted, corners);
+		unsigned* verts = &owned_poly_verts[polys[face_index].first_vertex];
+		unsigned slot_size = polys[face_index + 1].first_vertex - polys[face_index].first_vertex;
+		for(unsigned i = 0; i < slot_size; i++)
+			verts[i] = i < count ? corners[i] : NO_VERTEX;
+	}
+
+	// Builds a face's data unless it is built already.  The first thread to reach
+	// a pending face builds it while any other thread sampling it waits, and the
+	// release store publishes the data to every thread which sees the face built.
+	inline void WeightedSurface::build_face_once(unsigned face_index) const
+	{
+		if(!face_states)
+			return;
+		std::atomic<unsigned char>& state = face_states[face_index];
+		if(state.load(std::memory_order_acquire) == FACE_BUILT)
+			return;
+		unsigned char expected = FACE_PENDING;
+		if(state.compare_exchange_strong(expected, FACE_BUILDING, std::memory_order_acquire))
+		{
+			build_face(face_index);
+			built_face_count.fetch_add(1, std::memory_order_relaxed);
+			state.store(FACE_BUILT, std::memory_order_release);
+			return;
+		}
+		while(state.load(std::memory_order_acquire) != FACE_BUILT)
+			std::this_thread::yield();
+	}
+
+	// Builds the data of every face not built yet, spread over the given number
+	// of threads, before a surface is saved with all of its faces.
+	void WeightedSurface::build_faces(unsigned thread_count) const
+	{
+		if(get_built_face_count() == polygon_count)
+			return;
+		parallel_for(polygon_count, thread_count, [&](unsigned start, unsigned end)
+		{
+			for(unsigned i = start; i < end; i++)
+				build_face_once(i);
+		});
+	}
+
+	// Returns the number of faces whose data has been built.
+	unsigned WeightedSurface::get_built_face_count() const
+	{
+		return face_states ? built_face_count.load(std::memory_order_relaxed) : polygon_count;
+	}
+
+	// Returns the number of polygons in the surface.
+	unsigned WeightedSurface::get_polygon_count() const
+	{
+		return polygon_count;
+	}
+
+	// Makes an owned array hold the values of an array unless it already does.
+	template<typename T>
+	static void take_ownership(std::vector<T>& owned, const T* values, size_t count)
+	{
+		if(values != owned.data() || owned.size() != count)
+			owned.assign(values, values + count);
+	}
+
+	// Appends the vertices, weights and polygons of another surface, so several
+	// source meshes are sampled through one search tree.  The other surface's
+	// indices are offset past this surface's arrays, which become owned arrays.
+	// Returns false if the number of weight channels differs.
+	bool WeightedSurface::append_surface(const WeightedSurface& other)
+	{
+		if(vertex_count == 0 && triangle_count == 0)
+			channel_count = other.channel_count;
+		else if(other.channel_count != channel_count)
+			return false;
+
+		unsigned vertex_offset = vertex_count;
+		unsigned triangle_offset = triangle_count;
+		unsigned poly_vert_offset = poly_vert_count;
+
+		// faces built on demand keep their state, the faces of a fully built surface are built
+		if(face_states || other.face_states)
+		{
+			std::unique_ptr<std::atomic<unsigned char>[]> states(
+				new std::atomic<unsigned char>[polygon_count + other.polygon_count]);
+			for(unsigned i = 0; i < polygon_count; i++)
+				states[i].store(face_states ? face_states[i].load() : (unsigned char)FACE_BUILT);
+			for(unsigned i = 0; i < other.polygon_count; i++)
+				states[polygon_count + i].store(other.face_states ? other.face_states[i].load() :
+																	(unsigned char)FACE_BUILT);
+			built_face_count.store(get_built_face_count() + other.get_built_face_count());
+			face_states.swap(states);
+		}
+
+		// external and quantized weights are copied so this surface owns them all
+		double vertex_weights[WEIGHT_COUNT];
+		if(weights != owned_weights.data() || quantized_weights != NULL)
+		{
+			std::vector<double> own_weights((size_t)vertex_count * channel_count);
+			for(unsigned i = 0; i < vertex_count; i++)
+				memcpy(&own_weights[(size_t)i * channel_count], get_vertex_weights(i, vertex_weights),
+					   sizeof(double) * channel_count);
+			owned_weights.swap(own_weights);
+			quantized_weights = NULL;
+			std::vector<unsigned short>().swap(owned_quantized_weights);
+		}
+		for(unsigned i = 0; i < other.vertex_count; i++)
+		{
+			const double* values = other.get_vertex_weights(i, vertex_weights);
+			owned_weights.insert(owned_weights.end(), values, values + channel_count);
+		}
+
+		take_ownership(owned_positions, positions, vertex_count);
+		owned_positions.insert(owned_positions.end(), other.positions, other.positions + other.vertex_count);
+
+		take_ownership(owned_tris, tris, triangle_count);
+		for(unsigned i = 0; i < other.triangle_count; i++)
+		{
+			WeightedTriangle tri = other.tris[i];
+			tri.v0 += vertex_offset;
+			tri.v1 += vertex_offset;
+			tri.v2 += vertex_offset;
+			owned_tris.push_back(tri);
+		}
+
+		// the end marker of this surface's polygons is replaced by the other's polygons
+		if(polys != NULL)
+		{
+			take_ownership(owned_polys, polys, polygon_count + 1);
+			owned_polys.pop_back();
+		}
+		for(unsigned i = 0; other.polys != NULL && i <= other.polygon_count; i++)
+		{
+			WeightedPolygon poly = other.polys[i];
+			poly.first_triangle += triangle_offset;
+			poly.first_vertex += poly_vert_offset;
+			owned_polys.push_back(poly);
+		}
+		if(other.polys == NULL)
+		{
+			WeightedPolygon end_marker = {triangle_offset, poly_vert_offset};
+			owned_polys.push_back(end_marker);
+		}
+
+		take_ownership(owned_poly_verts, poly_verts, poly_vert_count);
+		for(unsigned i = 0; i < other.poly_vert_count; i++)
+		{
+			unsigned vertex = other.poly_verts[i];
+			owned_poly_verts.push_back(vertex == NO_VERTEX ? NO_VERTEX : vertex + vertex_offset);
+		}
+
+		vertex_count += other.vertex_count;
+		polygon_count += other.polygon_count;
+		triangle_count += other.triangle_count;
+		poly_vert_count += other.poly_vert_count;
+		positions = owned_positions.data();
+		weights = owned_weights.data();
+		tris = owned_tris.data();
+		polys = owned_polys.data();
+		poly_verts = owned_poly_verts.data();
+		return true;
+	}
+
+	// Tests a polygon's vertices to see if any have an equal position to the sample point.
+	int WeightedSurface::get_matching_vertex(unsigned face_index, const Point3d& sample_point) const
+	{
+		unsigned end = polys[face_index + 1].first_vertex;
+		for(unsigned i = polys[face_index].first_vertex; i < end && poly_verts[i] != NO_VERTEX; i++)
+		{
+			Point3d delta = subtract(sample_point, positions[poly_verts[i]]);
+			// Allow for a small error tolerance.
+			if(fabs(delta.x) < EPSILON &&
+			   fabs(delta.y) < EPSILON &&
+			   fabs(delta.z) < EPSILON)
+				return (int)poly_verts[i];
+		}
+		return -1;
+	}
+
+	// Find a polygon's triangle that contains the sample point.
+	unsigned WeightedSurface::get_intersected_triangle(unsigned face_index, const Point3d& sample_point) const
+	{
+		unsigned start = polys[face_index].first_triangle;
+		unsigned end = polys[face_index + 1].first_triangle;
+		const Point3d* points = positions;
+
+		// Perfrom a simple test to detemine what triangle
+		// contains the sample point.
+		for(unsigned i = start; i < end; i++)
+			if(tris[i].point_is_inside(points, sample_point))
+				return i;
+
+		// If not triangle could be found do a more sophisticated
+		// barycentric coordinate test to determine the triangle
+		// which contains the point.
+		for(unsigned i = start; i < end; i++)
+			if(tris[i].point_is_inside_bary(points, sample_point))
+				return i;
+
+		// This should never happen.
+		// Return first triangle by default.
+		return start;
+	}
+
+	// Samples the weights of a polygon at a point on its surface, blending
+	// the corners of the triangle containing it by the interpolation policy.
+	template<class Interpolation>
+	void WeightedSurface::sample_polygon(unsigned face_index, const Point3d& sample_point,
+										 double* out_weights) const
+	{
+		build_face_once(face_index);
+		int matching_vert = get_matching_vertex(face_index, sample_point);
+		if(matching_vert >= 0)
+		{
+			copy_weights(matching_vert, out_weights);
+			return;
+		}
+
+		const WeightedTriangle& tri = tris[get_intersected_triangle(face_index, sample_point)];
+		double w0[WEIGHT_COUNT];
+		double w1[WEIGHT_COUNT];
+		double w2[WEIGHT_COUNT];
+		tri.sample_weights<Interpolation>(positions, get_vertex_weights(tri.v0, w0), get_vertex_weights(tri.v1, w1),
+						   get_vertex_weights(tri.v2, w2), channel_count, sample_point, out_weights);
+		expand_channels(out_weights, channel_count, out_weights);
+	}
+
+	// Gets a copy of a vertex's weights.
+	void WeightedSurface::copy_weights(unsigned index, double* out_weights) const
+	{
+		expand_channels(get_vertex_weights(index, out_weights), channel_count, out_weights);
+	}
+
+	// Returns the channel_count weights of a vertex.  Double weights are
+	// returned in place, quantized weights are decoded into the buffer.
+	const double* WeightedSurface::get_vertex_weights(unsigned index, double* buffer) const
+	{
+		if(quantized_weights == NULL)
+			return &weights[(size_t)index * channel_count];
+		const unsigned short* values = &quantized_weights[(size_t)index * channel_count];
+		for(unsigned i = 0; i < channel_count; i++)
+			buffer[i] = weight_offset[i] + values[i] * weight_scale[i];
+		return buffer;
+	}
+
+	// Replaces the weights with 16-bit values spread evenly over the range of
+	// every channel, which are decoded as they are sampled.  This quarters the
+	// size of the weights so more of a large source stays in the cache.
+	// Returns the largest difference between a weight and its decoded value.
+	double WeightedSurface::quantize_weights()
+	{
+		if(quantized_weights != NULL || vertex_count == 0)
+			return 0.0;
+
+		size_t value_count = (size_t)vertex_count * channel_count;
+		for(unsigned c = 0; c < channel_count; c++)
+		{
+			double min_value = weights[c];
+			double max_value = weights[c];
+			for(size_t i = c; i < value_count; i += channel_count)
+			{
+				min_value = std::min(min_value, weights[i]);
+				max_value = std::max(max_value, weights[i]);
+			}
+			weight_offset[c] = min_value;
+			weight_scale[c] = (max_value - min_value) / QUANTIZED_WEIGHT_MAX;
+		}
+
+		double max_error = 0.0;
+		std::vector<unsigned short> values(value_count);
+		for(size_t i = 0; i < value_count; i++)
+		{
+			unsigned c = (unsigned)(i % channel_count);
+			unsigned short value = 0;
+			if(weight_scale[c] > 0.0)
+			{
+				double scaled = floor((weights[i] - weight_offset[c]) / weight_scale[c] + 0.5);
+				value = (unsigned short)std::min(scaled, (double)QUANTIZED_WEIGHT_MAX);
+			}
+			values[i] = value;
+			max_error = std::max(max_error, fabs(weight_offset[c] + value * weight_scale[c] - weights[i]));
+		}
+
+		owned_quantized_weights.swap(values);
+		quantized_weights = owned_quantized_weights.data();
+		weights = NULL;
+		std::vector<double>().swap(owned_weights);
+		return max_error;
+	}
+
+	// Returns true if the weights are quantized.
+	bool WeightedSurface::is_quantized() const
+	{
+		return quantized_weights != NULL;
+	}
+
+	// Builds the closest point search tree over the triangles, spread over the given number of threads.
+	void WeightedSurface::build_tree(unsigned thread_count)
+	{
+		if(triangle_count == 0)
+			return;
+		tree.build(positions, tris, triangle_count, thread_count);
+		build_vertex_triangles();
+	}
+
+	// Lists the triangles around every vertex in compressed
+	// row form, for walking between neighbouring triangles.
+	void WeightedSurface::build_vertex_triangles()
+	{
+		vertex_tri_offsets.assign(vertex_count + 1, 0);
+		for(unsigned i = 0; i < triangle_count; i++)
+		{
+			vertex_tri_offsets[tris[i].v0 + 1]++;
+			vertex_tri_offsets[tris[i].v1 + 1]++;
+			vertex_tri_offsets[tris[i].v2 + 1]++;
+		}
+		for(unsigned i = 0; i < vertex_count; i++)
+			vertex_tri_offsets[i + 1] += vertex_tri_offsets[i];
+
+		vertex_tris.resize(vertex_tri_offsets[vertex_count]);
+		std::vector<unsigned> next(vertex_tri_offsets.begin(), vertex_tri_offsets.end() - 1);
+		for(unsigned i = 0; i < triangle_count; i++)
+		{
+			vertex_tris[next[tris[i].v0]++] = i;
+			vertex_tris[next[tris[i].v1]++] = i;
+			vertex_tris[next[tris[i].v2]++] = i;
+		}
+	}
+
+	// Copies the weights of a vertex which coincides with the sample position, if any.
+	bool WeightedSurface::sample_vertex(const Point3d& sample_point, double* out_weights) const
+	{
+		int vertex_index = vertex_hash.find(sample_point);
+		if(vertex_index < 0)
+			return false;
+		copy_weights(vertex_index, out_weights);
+		return true;
+	}
+
+	// Samples the weights at the closest point on the surface to an arbitrary position in space,
+	// searching no further than the maximum distance unless it is negative.  The distance to
+	// the closest point is returned, or DBL_MAX with zero weights if none is within range.
+	template<class Interpolation>
+	void WeightedSurface::sample_surface(const Point3d& sample_point,
+										 double max_distance,
+										 double* out_weights,
+										 double& out_distance) const
+	{
+		unsigned tri_index;
+		Point3d closest_pos;
+		if(!tree.find_closest(positions, tris, sample_point, max_distance, tri_index, closest_pos))
+		{
+			memset(out_weights, 0, sizeof(double) * WEIGHT_COUNT);
+			out_distance = DBL_MAX;
+			return;
+		}
+		out_distance = sqrt(get_distance_sq(sample_point, closest_pos));
+		sample_polygon<Interpolation>(get_triangle_face(tri_index), closest_pos, out_weights);
+	}
+
+	// Samples the weights at the closest point on the surface to an arbitrary position,
+	// walking from the closest triangle of the previous nearby position in the seed.
+	// Seeds further away than a few triangles are not used, as the walk can stop at
+	// a local minimum on the far side of a curved surface.  The walk is rejected,
+	// and the tree searched instead, when it takes too many steps or ends further
+	// away than the previous distance plus the distance between the positions,
+	// which the closest point can never be, or beyond the maximum distance, as a
+	// closer point within range may still exist.  The seed is updated with the result
+	// and the distance is returned as by sample_surface.
+	// Returns true if the walk was used rather than a global search.
+	template<class Interpolation>
+	bool WeightedSurface::sample_surface_from(const Point3d& sample_point,
+											  double max_distance,
+											  SearchSeed& seed,
+											  double* out_weights,
+											  double& out_distance) const
+	{
+		unsigned tri_index;
+		Point3d closest_pos;
+		bool walked;
+		if(!find_closest_from(sample_point, max_distance, seed, tri_index, closest_pos, walked))
+		{
+			memset(out_weights, 0, sizeof(double) * WEIGHT_COUNT);
+			out_distance = DBL_MAX;
+			return false;
+		}
+		out_distance = seed.distance;
+		sample_polygon<Interpolation>(get_triangle_face(tri_index), closest_pos, out_weights);
+		return walked;
+	}
+
+	// Finds the closest triangle and point on the surface to a position within a
+	// maximum distance, walking from the seed's triangle as sample_surface_from
+	// describes, and updates the seed with the result.  Returns false, and clears
+	// the seed, if no point is in range.  The walked flag is set when the walk
+	// was used rather than a global search.
+	bool WeightedSurface::find_closest_from(const Point3d& sample_point,
+											double max_distance,
+											SearchSeed& seed,
+											unsigned& tri_index,
+											Point3d& closest_pos,
+											bool& walked) const
+	{
+		tri_index = seed.triangle;
+		walked = false;
+		if(tri_index < triangle_count && !vertex_tris.empty() &&
+		   get_distance_sq(sample_point, seed.position) <= get_seed_range_sq(tri_index) &&
+		   walk_to_closest(sample_point, tri_index, closest_pos))
+		{
+			double distance_bound = seed.distance + sqrt(get_distance_sq(sample_point, seed.position));
+			double distance = sqrt(get_distance_sq(sample_point, closest_pos));
+			walked = distance <= distance_bound + EPSILON && (max_distance < 0.0 || distance <= max_distance);
+		}
+		if(!walked && !tree.find_closest(positions, tris, sample_point, max_distance, tri_index, closest_pos))
+		{
+			seed.triangle = NO_TRIANGLE;
+			return false;
+		}
+
+		seed.triangle = tri_index;
+		seed.position = sample_point;
+		seed.distance = sqrt(get_distance_sq(sample_point, closest_pos));
+		return true;
+	}
+
+	// Returns the vertices and coefficients a sample of a polygon at a point on its
+	// surface blends.  The coefficients are found by blending unit weights at the
+	// corners of the triangle containing the point through the interpolation policy,
+	// so they are the policy's own factors and only valid for linear policies.
+	// Corners with a zero coefficient are left out of the stencil.
+	template<class Interpolation>
+	void WeightedSurface::get_polygon_stencil(unsigned face_index, const Point3d& sample_point,
+											  SampleStencil& stencil) const
+	{
+		build_face_once(face_index);
+		int matching_vert = get_matching_vertex(face_index, sample_point);
+		if(matching_vert >= 0)
+		{
+			stencil.count = 1;
+			stencil.vertices[0] = (unsigned)matching_vert;
+			stencil.coefficients[0] = 1.0;
+			return;
+		}
+
+		const WeightedTriangle& tri = tris[get_intersected_triangle(face_index, sample_point)];
+		static const double unit_weights[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+		double coefficients[WEIGHT_COUNT];
+		tri.sample_weights<Interpolation>(positions, unit_weights[0], unit_weights[1], unit_weights[2], 3,
+										  sample_point, coefficients);
+		unsigned corners[3] = {tri.v0, tri.v1, tri.v2};
+		stencil.count = 0;
+		for(unsigned i = 0; i < 3; i++)
+		{
+			if(coefficients[i] == 0.0)
+				continue;
+			stencil.vertices[stencil.count] = corners[i];
+			stencil.coefficients[stencil.count] = coefficients[i];
+			stencil.count++;
+		}
+	}
+
+	// Returns the vertex which coincides with the sample position, if any, as a stencil.
+	bool WeightedSurface::get_vertex_stencil(const Point3d& sample_point, SampleStencil& stencil) const
+	{
+		int vertex_index = vertex_hash.find(sample_point);
+		if(vertex_index < 0)
+			return false;
+		stencil.count = 1;
+		stencil.vertices[0] = (unsigned)vertex_index;
+		stencil.coefficients[0] = 1.0;
+		return true;
+	}
+
+	// Returns the stencil of the closest point on the surface to an arbitrary position,
+	// searching as sample_surface does.  The stencil is empty and the distance DBL_MAX
+	// if no point is within range.
+	template<class Interpolation>
+	void WeightedSurface::get_surface_stencil(const Point3d& sample_point,
+											  double max_distance,
+											  SampleStencil& stencil,
+											  double& out_distance) const
+	{
+		unsigned tri_index;
+		Point3d closest_pos;
+		if(!tree.find_closest(positions, tris, sample_point, max_distance, tri_index, closest_pos))
+		{
+			stencil.count = 0;
+			out_distance = DBL_MAX;
+			return;
+		}
+		out_distance = sqrt(get_distance_sq(sample_point, closest_pos));
+		get_polygon_stencil<Interpolation>(get_triangle_face(tri_index), closest_pos, stencil);
+	}
+
+	// Returns the stencil of the closest point on the surface to an arbitrary position,
+	// walking from the seed as sample_surface_from does.  Returns true if the walk was
+	// used rather than a global search.
+	template<class Interpolation>
+	bool WeightedSurface::get_surface_stencil_from(const Point3d& sample_point,
+												   double max_distance,
+												   SearchSeed& seed,
+												   SampleStencil& stencil,
+												   double& out_distance) const
+	{
+		unsigned tri_index;
+		Point3d closest_pos;
+		bool walked;
+		if(!find_closest_from(sample_point, max_distance, seed, tri_index, closest_pos, walked))
+		{
+			stencil.count = 0;
+			out_distance = DBL_MAX;
+			return false;
+		}
+		out_distance = seed.distance;
+		get_polygon_stencil<Interpolation>(get_triangle_face(tri_index), closest_pos, stencil);
+		return walked;
+	}
+
+	// Returns the squared distance from a seed position within which
+	// its triangle is used to start a walk, MAX_SEED_JUMP longest edges.
+	double WeightedSurface::get_seed_range_sq(unsigned tri_index) const
+	{
+		const WeightedTriangle& tri = tris[tri_index];
+		double edge_sq = std::max(get_distance_sq(positions[tri.v0], positions[tri.v1]),
+								  std::max(get_distance_sq(positions[tri.v1], positions[tri.v2]),
+										   get_distance_sq(positions[tri.v2], positions[tri.v0])));
+		return edge_sq * MAX_SEED_JUMP * MAX_SEED_JUMP;
+	}
+
+	// Walks from a triangle to the closest of the triangles sharing a vertex with
+	// it while that one is closer to the sample point, or as close with a lower
+	// index so the walk never cycles.  Returns the last triangle and its closest
+	// point, or false if no local minimum is reached within MAX_WALK_STEPS.
+	bool WeightedSurface::walk_to_closest(const Point3d& sample_point,
+										  unsigned& tri_index,
+										  Point3d& closest_pos) const
+	{
+		const WeightedTriangle& start = tris[tri_index];
+		closest_pos = closest_point_on_triangle(sample_point, positions[start.v0],
+												positions[start.v1], positions[start.v2]);
+		double best_distance_sq = get_distance_sq(sample_point, closest_pos);
+
+		for(unsigned step = 0; step < MAX_WALK_STEPS; step++)
+		{
+			unsigned current = tri_index;
+			unsigned corners[3] = {tris[current].v0, tris[current].v1, tris[current].v2};
+			for(unsigned c = 0; c < 3; c++)
+			{
+				for(unsigned i = vertex_tri_offsets[corners[c]]; i < vertex_tri_offsets[corners[c] + 1]; i++)
+				{
+					unsigned neighbour = vertex_tris[i];
+					if(neighbour == current)
+						continue;
+					const WeightedTriangle& tri = tris[neighbour];
+					Point3d closest = closest_point_on_triangle(sample_point, positions[tri.v0],
+																positions[tri.v1], positions[tri.v2]);
+					double distance_sq = get_distance_sq(sample_point, closest);
+					if(distance_sq < best_distance_sq ||
+					   (distance_sq == best_distance_sq && neighbour < tri_index))
+					{
+						best_distance_sq = distance_sq;
+						tri_index = neighbour;
+						closest_pos = closest;
+					}
+				}
+			}
+			if(tri_index == current)
+				return true;
+		}
+		return false;
+	}
+
+	// Returns the index of the polygon a triangle belongs to.
+	unsigned WeightedSurface::get_triangle_face(unsigned tri_index) const
+	{
+		// find the last polygon which starts at or before the triangle
+		unsigned low = 0;
+		unsigned high = polygon_count;
+		while(high - low > 1)
+		{
+			unsigned middle = (low + high) / 2;
+			if(polys[middle].first_triangle <= tri_index)
+				low = middle;
+			else
+				high = middle;
+		}
+		return low;
+	}
+
+	// Hashes the vertex positions for find_vertex.
+	void WeightedSurface::build_vertex_hash()
+	{
+		vertex_hash.build(positions, vertex_count);
+	}
+
+	// Returns the index of a vertex equal to the sample point or -1.
+	int WeightedSurface::find_vertex(const Point3d& sample_point) const
+	{
+		return vertex_hash.find(sample_point);
+	}
+
+	// Returns the arrays of the built surface.
+	void WeightedSurface::get_buffers(SurfaceBuffers& buffers) const
+	{
+		buffers.vertex_count = vertex_count;
+		buffers.channel_count = channel_count;
+		buffers.polygon_count = polygon_count;
+		buffers.triangle_count = triangle_count;
+		buffers.poly_vert_count = poly_vert_count;
+		buffers.positions = positions;
+		buffers.weights = weights;
+		buffers.quantized_weights = quantized_weights;
+		buffers.weight_scale = weight_scale;
+		buffers.weight_offset = weight_offset;
+		buffers.tris = tris;
+		buffers.polys = polys;
+		buffers.poly_verts = poly_verts;
+		buffers.nodes = tree.get_nodes(buffers.node_count);
+		buffers.tri_order = tree.get_triangle_order();
+	}
+
+	// Samples from the external arrays of a built surface, such as a
+	// mapped source file, instead of owned arrays.  Only the vertex
+	// hash is rebuilt.
+	void WeightedSurface::set_buffers(const SurfaceBuffers& buffers)
+	{
+		vertex_count = buffers.vertex_count;
+		channel_count = buffers.channel_count;
+		polygon_count = buffers.polygon_count;
+		triangle_count = buffers.triangle_count;
+		poly_vert_count = buffers.poly_vert_count;
+		positions = buffers.positions;
+		weights = buffers.weights;
+		quantized_weights = buffers.quantized_weights;
+		if(quantized_weights != NULL)
+		{
+			memcpy(weight_scale, buffers.weight_scale, sizeof(double) * channel_count);
+			memcpy(weight_offset, buffers.weight_offset, sizeof(double) * channel_count);
+		}
+		tris = buffers.tris;
+		polys = buffers.polys;
+		poly_verts = buffers.poly_verts;
+		std::vector<Point3d>().swap(owned_positions);
+		std::vector<double>().swap(owned_weights);
+		std::vector<unsigned short>().swap(owned_quantized_weights);
+		std::vector<WeightedTriangle>().swap(owned_tris);
+		std::vector<WeightedPolygon>().swap(owned_polys);
+		std::vector<unsigned>().swap(owned_poly_verts);
+		face_states.reset();
+
+		tree.set_buffers(buffers.nodes, buffers.node_count, buffers.tri_order);
+		build_vertex_triangles();
+		build_vertex_hash();
+	}
+
+	// Returns the number of vertices in the surface.
+	unsigned WeightedSurface::get_vertex_count() const
+	{
+		return vertex_count;
+	}
+
+	// Returns the number of weight channels per vertex.
+	unsigned WeightedSurface::get_channel_count() const
+	{
+		return channel_count;
+	}
+
+	// Returns the number of triangles in the surface.
+	unsigned WeightedSurface::get_triangle_count() const
+	{
+		return triangle_count;
+	}
+
+	// Returns the number of bytes used by the surface arrays.
+	size_t WeightedSurface::get_memory_size() const
+	{
+		return owned_positions.capacity() * sizeof(Point3d) +
+			   owned_weights.capacity() * sizeof(double) +
+			   owned_quantized_weights.capacity() * sizeof(unsigned short) +
+			   owned_tris.capacity() * sizeof(WeightedTriangle) +
+			   owned_polys.capacity() * sizeof(WeightedPolygon) +
+			   owned_poly_verts.capacity() * sizeof(unsigned) +
+			   (vertex_tri_offsets.capacity() + vertex_tris.capacity()) * sizeof(unsigned) +
+			   tree.get_memory_size();
+	}
+
+	// Returns the bytes per triangle of the previous pointer-based layout.
+	size_t WeightedSurface::get_legacy_triangle_size()
+	{
+		return sizeof(LegacyTriangleLayout);
+	}
+
+	// The hash cells are twice the tolerance wide so the tolerance box
+	// around any sample point overlaps at most two cells along each axis.
+	static const double HASH_CELL_SIZE = EPSILON * 2.0;
+
+	// Hashes an array of vertex positions.
+	void VertexHash::build(const Point3d* points, unsigned count)
+	{
+		positions = points;
+		cells.clear();
+		cells.reserve(count);
+		next_vertex.assign(count, -1);
+
+		// Insert in reverse so each cell lists its vertices in index order.
+		for(int i = (int)count - 1; i >= 0; i--)
+		{
+			CellKey key = {get_cell(points[i].x), get_cell(points[i].y), get_cell(points[i].z)};
+			std::pair<std::unordered_map<CellKey, int, CellKeyHash>::iterator, bool> inserted;
+			inserted = cells.insert(std::make_pair(key, i));
+			if(!inserted.second)
+			{
+				next_vertex[i] = inserted.first->second;
+				inserted.first->second = i;
+			}
+		}
+	}
+
+	// Returns the index of a vertex equal to the sample point or -1.
+	int VertexHash::find(const Point3d& sample_point) const
+	{
+		if(cells.empty())
+			return -1;
+
+		// the range of cells overlapped by the tolerance box
+		long long min_x = get_cell(sample_point.x - EPSILON);
+		long long max_x = get_cell(sample_point.x + EPSILON);
+		long long min_y = get_cell(sample_point.y - EPSILON);
+		long long max_y = get_cell(sample_point.y + EPSILON);
+		long long min_z = get_cell(sample_point.z - EPSILON);
+		long long max_z = get_cell(sample_point.z + EPSILON);
+
+		CellKey key;
+		for(key.x = min_x; key.x <= max_x; key.x++)
+			for(key.y = min_y; key.y <= max_y; key.y++)
+				for(key.z = min_z; key.z <= max_z; key.z++)
+				{
+					std::unordered_map<CellKey, int, CellKeyHash>::const_iterator cell = cells.find(key);
+					if(cell == cells.end())
+						continue;
+					for(int i = cell->second; i >= 0; i = next_vertex[i])
+					{
+						Point3d delta = subtract(sample_point, positions[i]);
+						// Use the same tolerance as get_matching_vertex.
+						if(fabs(delta.x) < EPSILON &&
+						   fabs(delta.y) < EPSILON &&
+						   fabs(delta.z) < EPSILON)
+							return i;
+					}
+				}
+		return -1;
+	}
+
+	// Quantizes a coordinate to its cell index.
+	long long VertexHash::get_cell(double value) const
+	{
+		return (long long)floor(value / HASH_CELL_SIZE);
+	}
+
+	// Set the three vertex indices that make up this triangle and
+	// store relevant triangle information.
+	void WeightedTriangle::set_vertices(const Point3d* points,
+										unsigned new_v0,
+										unsigned new_v1,
+										unsigned new_v2)
+	{
+		// store vertex indices as class attributes
+		v0 = new_v0;
+		v1 = new_v1;
+		v2 = new_v2;
+		set_plane(points);
+	}
+
+	// Stores the normal, major axis and area of this triangle from the positions
+	// of its vertices.  Only these members are written, so other threads may read
+	// the vertex indices meanwhile.
+	void WeightedTriangle::set_plane(const Point3d* points)
+	{
+		const Point3d& p0 = points[v0];
+		const Point3d& p1 = points[v1];
+		const Point3d& p2 = points[v2];
+
+		// calculate triangle normal and area
+		//
+		Point3d n = cross(subtract(p1, p0), subtract(p2, p0));
+		double area_times_2 = length(n);
+		if(area_times_2 > 0.0)
+		{
+			n.x /= area_times_2;
+			n.y /= area_times_2;
+			n.z /= area_times_2;
+			inv_area_times_2 = (float)(1.0 / area_times_2);
+		}
+		else
+		{
+			// a degenerate triangle never contains a sample point
+			inv_area_times_2 = 0.0f;
+		}
+		normal[0] = (float)n.x;
+		normal[1] = (float)n.y;
+		normal[2] = (float)n.z;
+
+		// The major axis is the largest absolute component of the triangle's
+		// normal.  The major axis is the axis along which points on this triangle
+		// will be project into 2D. This ensures we get the least distorted
+		// 2D approximation and never project to a line.
+		Point3d abs_normal = {fabs(n.x), fabs(n.y), fabs(n.z)};
+		if(abs_normal.x > abs_normal.y)
+		{
+			if(abs_normal.x > abs_normal.z)
+				major_axis = X_AXIS;
+			else if(abs_normal.y > abs_normal.z)
+				major_axis = Y_AXIS;
+			else
+				major_axis = Z_AXIS;
+		}
+		else
+		{
+			if(abs_normal.y > abs_normal.z)
+				major_axis = Y_AXIS;
+			else
+				major_axis = Z_AXIS;
+		}
+	}
+
+	// Calculates and returns the weights of this triangle at the specified sample
+	// position, blended from the weights of its three vertices by the policy.
+	template<class Interpolation>
+	void WeightedTriangle::sample_weights(const Point3d* points, const double* w0,
+										  const double* w1, const double* w2,
+										  unsigned channel_count, const Point3d& sample_point,
+										  double* out_weights) const
+	{
+		double bary_coords[3];
+		get_bary_coords(points, sample_point, true, bary_coords);
+		const double* corner_weights[3] = {w0, w1, w2};
+		Interpolation::blend(corner_weights, bary_coords, channel_count, out_weights);
+	}
+
+	// Performs a fast test of the sample point to see if it is inside this triangle.
+	bool WeightedTriangle::point_is_inside(const Point3d* points, const Point3d& sample_point) const
+	{
+		if(!point_is_on_plane(points, sample_point))
+			return false;
+
+		Point2d sample_2d = project_to_2d(sample_point);
+		Point2d v0_2d = project_to_2d(points[v0]);
+		Point2d v1_2d = project_to_2d(points[v1]);
+		Point2d v2_2d = project_to_2d(points[v2]);
+		// adjust the 2D triangle so that the sample point is the origin.
+		Point2d adj_v0 = {v0_2d.x - sample_2d.x, v0_2d.y - sample_2d.y};
+		Point2d adj_v1 = {v1_2d.x - sample_2d.x, v1_2d.y - sample_2d.y};
+		Point2d adj_v2 = {v2_2d.x - sample_2d.x, v2_2d.y - sample_2d.y};
+
+		// Test to see how many adjusted triangle edges intersect the positive X-axis.
+		unsigned intersections = 0;
+		if(edge_crosses_x_axis(adj_v0, adj_v1))
+			intersections++;
+		if(edge_crosses_x_axis(adj_v1, adj_v2))
+			intersections++;
+		if(edge_crosses_x_axis(adj_v0, adj_v2))
+			intersections++;
+
+		// An odd number of intersection indicates the sample point is inside the triangle.
+		return (intersections % 2 == 1);
+	}
+	
+	// Tests the sample point to see if it lies in the plane of the triangle.
+	bool WeightedTriangle::point_is_on_plane(const Point3d* points, const Point3d& sample_point) const
+	{
+		// The centroid is cheaper to recompute than to store.
+		const Point3d& p0 = points[v0];
+		const Point3d& p1 = points[v1];
+		const Point3d& p2 = points[v2];
+		Point3d centroid = {(p0.x + p1.x + p2.x) / 3.0,
+							(p0.y + p1.y + p2.y) / 3.0,
+							(p0.z + p1.z + p2.z) / 3.0};
+
+		// direction from point on triangle to the sample position
+		Point3d sample_direction = subtract(sample_point, centroid);
+		double sample_distance = length(sample_direction);
+		if(sample_distance == 0.0)
+			return true;
+
+		// dot product of sample direction and normal direction
+		double cos_theta = (sample_direction.x * normal[0] +
+							sample_direction.y * normal[1] +
+							sample_direction.z * normal[2]) / sample_distance;
+		// A result close to zero indicates the sample
+		// direction is orthogonal to the triangle noraml.
+		return fabs(cos_theta) < EPSILON;
+	}
+
+	// Tests the sample point to see if it is inside this triangle using barycentric coordinates.
+	bool WeightedTriangle::point_is_inside_bary(const Point3d* points, const Point3d& sample_point) const
+	{
+		double bary_coords[3];
+		get_bary_coords(points, sample_point, false, bary_coords);
+		double total_area = bary_coords[0] + bary_coords[1] + bary_coords[2];
+		return fabs(1.0 - total_area) < EPSILON;
+	}
+
+	// Calculates the barycentric coordinates of the sample point in this triangle.
+	void WeightedTriangle::get_bary_coords(const Point3d* points, const Point3d& sample_point,
+										   bool normalized, double* out_bary_coords) const
+	{
+		// Calculate areas of triangle fragmenets created
+		// by sample point inside of large triangle.
+		Point3d e0 = subtract(points[v0], sample_point);
+		Point3d e1 = subtract(points[v1], sample_point);
+		Point3d e2 = subtract(points[v2], sample_point);
+		
+		// Each bary coordinate is defined as the fraction of the
+		// larger area occupied by each triangle fragment.
+		out_bary_coords[0] = length(cross(e2, e1)) * inv_area_times_2;
+		out_bary_coords[1] = length(cross(e0, e2)) * inv_area_times_2;
+
+		if(normalized)
+		{
+			// Calculating the final coordinate this ways is faster
+			// and guarantees normalized coordinates that sum to 1.
+			out_bary_coords[2] = 1 - (out_bary_coords[1] + out_bary_coords[0]);
+		}
+		else
+		{
+			// Calculate the true coordinates which may sum to more than 1/
+			out_bary_coords[2] = length(cross(e0, e1)) * inv_area_times_2;
+		}
+	}
+
+	// Projects a 3D point into 2D by removing a vector component.
+	Point2d WeightedTriangle::project_to_2d(const Point3d& position) const
+	{
+		Point2d pos_2d;
+		switch(major_axis)
+		{
+			case X_AXIS:
+				pos_2d.x = position.y;
+				pos_2d.y = position.z;
+				break;
+			case Y_AXIS:
+				pos_2d.x = position.x;
+				pos_2d.y = position.z;
+				break;
+			default:
+				pos_2d.x = position.x;
+				pos_2d.y = position.y;
+				break;
+		}
+		return pos_2d;
+	}
+
+	// Instantiates the sample methods for an interpolation policy.
+	#define INSTANTIATE_SAMPLE_METHODS(Interpolation)														\
+		template void WeightedSurface::sample_polygon<Interpolation>(unsigned, const Point3d&, double*) const;	\
+		template void WeightedSurface::sample_surface<Interpolation>(const Point3d&, double, double*, double&) const;	\
+		template bool WeightedSurface::sample_surface_from<Interpolation>(const Point3d&, double, SearchSeed&,		\
+																		  double*, double&) const;	\
+		template void WeightedSurface::get_polygon_stencil<Interpolation>(unsigned, const Point3d&,			\
+																		  SampleStencil&) const;			\
+		template void WeightedSurface::get_surface_stencil<Interpolation>(const Point3d&, double,			\
+																		  SampleStencil&, double&) const;	\
+		template bool WeightedSurface::get_surface_stencil_from<Interpolation>(const Point3d&, double,		\
+																			   SearchSeed&, SampleStencil&,	\
+																			   double&) const;
+
+	INSTANTIATE_SAMPLE_METHODS(LinearInterpolation)
+	INSTANTIATE_SAMPLE_METHODS(NearestInterpolation)
+	INSTANTIATE_SAMPLE_METHODS(MaxInterpolation)
+	INSTANTIATE_SAMPLE_METHODS(SmoothInterpolation)
+} // end namespace WeightTransferTool
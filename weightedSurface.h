@@ -0,0 +1,321 @@
+
+#ifndef __WEIGHTED_SURFACE__
+#define __WEIGHTED_SURFACE__
+
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include <triangleTree.h>
+#include <weightInterpolation.h>
+
+namespace WeightTransferTool
+{
+	// a small number for comparing double vales
+	const double EPSILON = 1E-5;
+
+	// the number of weight values stored for each vertex
+	const unsigned WEIGHT_COUNT = 4;
+
+	// the triangle index which marks a seeded search without a seed
+	const unsigned NO_TRIANGLE = 0xFFFFFFFF;
+	// the polygon vertex list entry which pads the list of a polygon built on demand
+	const unsigned NO_VERTEX = 0xFFFFFFFF;
+	// the largest number of steps the seeded closest point walk takes before falling back
+	const unsigned MAX_WALK_STEPS = 32;
+	// the furthest a seed is used from, in longest edges of the seed triangle
+	const double MAX_SEED_JUMP = 4.0;
+	// the largest quantized weight value, which decodes to the top of its channel's range
+	const unsigned QUANTIZED_WEIGHT_MAX = 65535;
+
+	// a two dimensional point position
+	struct Point2d
+	{
+		double x;
+		double y;
+	};
+
+	// a three dimensional point position
+	struct Point3d
+	{
+		double x;
+		double y;
+		double z;
+	};
+
+	// enumeration to indicate the
+    // largest axis of a vector
+	enum MajorAxis
+	{
+		X_AXIS = 1,
+		Y_AXIS = 2,
+		Z_AXIS = 3,
+	};
+
+	// Tests two 2D points to see if the line segment they define crosses the positive X-axis.
+	bool edge_crosses_x_axis(const Point2d&, const Point2d&);
+	// Returns true if the number is greater than or equal to zero, false otherwise.
+	bool simple_sign(double number);
+	// Expands the channels of an attribute value into WEIGHT_COUNT weights the
+	// way a Maya weight attribute does.  The arrays may be the same.
+	void expand_channels(const double*, unsigned, double*);
+
+	// A compact triangle record.  Vertices are referenced by their 32-bit index
+	// into the owning surface's vertex arrays and only the values needed to pick
+	// and interpolate the triangle are precomputed, so two records share a cache line.
+	class WeightedTriangle
+	{
+		public:
+			void set_vertices(const Point3d*, unsigned,
+							  unsigned, unsigned);	// Set the three vertex indices that make up this triangle and
+													// store relevant triangle information.
+			void set_plane(const Point3d*);			// Stores the normal, major axis and area of the triangle.
+			template<class Interpolation>
+			void sample_weights(const Point3d*,		// Calculates and returns the weights of this triangle
+								const double*,		// at the specified sample position, blended from the
+								const double*,		// weights of its three vertices by the interpolation
+								const double*,		// policy, for weights with the given number of channels.
+								unsigned,
+								const Point3d&,
+								double*) const;
+
+			bool point_is_inside(const Point3d*,
+								 const Point3d&) const;		// Performs a fast test of the sample point to see if
+															// it is inside this triangle.
+			bool point_is_on_plane(const Point3d*,
+								   const Point3d&) const;	// Tests the sample point to see if it lies in the plane of the triangle.
+			bool point_is_inside_bary(const Point3d*,
+									  const Point3d&) const;// Tests the sample point to see if it is inside this
+															// triangle using barycentric coordinates.
+
+			unsigned v0;							// The index of the first weighted vertex of the triangle.
+			unsigned v1;							// The index of the second weighted vertex of the triangle.
+			unsigned v2;							// The index of the third weighted vertex of the triangle.
+
+		private:
+			void get_bary_coords(const Point3d*,	// Calculates the barycentric coordinates
+								 const Point3d&,	// of the sample point in this triangle.
+								 bool, double*) const;
+			Point2d project_to_2d(const Point3d&) const;	// Projects a 3D point into 2D by removing a vector component.
+
+			unsigned major_axis;					// The major axis of the triangle. (i.e. its facing direction)
+			float normal[3];						// The triangle normal direction.
+			float inv_area_times_2;					// The reciprocal of two times the area of the triangle.
+	};
+
+	// A polygon is stored as the offsets of its first triangle and first unique
+	// vertex in the surface arrays.  Its ranges end where the next polygon's begin.
+	struct WeightedPolygon
+	{
+		unsigned first_triangle;				// The index of this polygon's first triangle.
+		unsigned first_vertex;					// The offset of this polygon's first entry in the polygon vertex list.
+	};
+
+	// A spatial hash of vertex positions quantized to the EPSILON
+	// tolerance.  It finds the vertex which coincides with a sample
+	// point without a closest point query.
+	class VertexHash
+	{
+		public:
+			VertexHash(){ positions = NULL; };		// VertexHash class constructor.
+			~VertexHash(){};						// VertexHash class deconstructor.
+			void build(const Point3d*, unsigned);	// Hashes an array of vertex positions.
+			int find(const Point3d&) const;			// Returns the index of a vertex equal to the sample point or -1.
+
+		private:
+			struct CellKey
+			{
+				long long x;
+				long long y;
+				long long z;
+				bool operator==(const CellKey& other) const
+				{
+					return x == other.x && y == other.y && z == other.z;
+				}
+			};
+			struct CellKeyHash
+			{
+				size_t operator()(const CellKey& key) const
+				{
+					return (size_t)(key.x * 73856093LL ^ key.y * 19349663LL ^ key.z * 83492791LL);
+				}
+			};
+			long long get_cell(double) const;		// Quantizes a coordinate to its cell index.
+
+			const Point3d* positions;				// The hashed vertex positions.
+			std::unordered_map<CellKey, int, CellKeyHash> cells;	// The first vertex in every occupied cell.
+			std::vector<int> next_vertex;			// The next vertex in the same cell or -1.
+	};
+
+	// The result of the previous seeded closest point search,
+	// which starts the search for the next nearby position.
+	struct SearchSeed
+	{
+		unsigned triangle;						// The closest triangle, NO_TRIANGLE before the first search.
+		Point3d position;						// The sample position of the search.
+		double distance;						// The distance from the sample position to the surface.
+	};
+
+	// The source vertices a sample blends and their coefficients.  The weights of
+	// the sample are the sum of every vertex's weights times its coefficient.
+	struct SampleStencil
+	{
+		unsigned count;							// The number of vertices blended, zero out of range.
+		unsigned vertices[3];					// The index of every vertex blended.
+		double coefficients[3];					// The coefficient of every vertex blended.
+	};
+
+	// The flat arrays of a built surface, used to save a surface
+	// and to sample one directly from a mapped source file.
+	struct SurfaceBuffers
+	{
+		unsigned vertex_count;					// The number of vertex positions.
+		unsigned channel_count;					// The number of weight channels per vertex.
+		unsigned polygon_count;					// The number of polygons, excluding the end marker.
+		unsigned triangle_count;				// The number of triangles and of triangle order entries.
+		unsigned poly_vert_count;				// The number of polygon vertex list entries.
+		unsigned node_count;					// The number of search tree nodes.
+		const Point3d* positions;				// The world space position of every vertex.
+		const double* weights;					// channel_count weights for every vertex, NULL when quantized.
+		const unsigned short* quantized_weights;	// channel_count quantized weights for every vertex or NULL.
+		const double* weight_scale;				// The decoding scale of every quantized channel.
+		const double* weight_offset;			// The decoding offset of every quantized channel.
+		const WeightedTriangle* tris;			// The triangles of every polygon.
+		const WeightedPolygon* polys;			// The polygon ranges, plus an end marker.
+		const unsigned* poly_verts;				// The unique vertex indexes of every polygon.
+		const TreeNode* nodes;					// The search tree nodes.
+		const unsigned* tri_order;				// The triangle indices in tree leaf order.
+	};
+
+	// this class stores the triangulated, weighted
+	// surface of a mesh in flat index-based arrays.
+	class WeightedSurface
+	{
+		public:
+			WeightedSurface();						// WeightedSurface class constructor.
+			~WeightedSurface(){};					// WeightedSurface class deconstructor.
+			void set_vertex_count(unsigned,			// Allocates the vertex position and weight arrays for
+								  unsigned);		// the given number of weight channels per vertex.
+			void set_weight_buffer(const double*,	// Samples weights from an external buffer, such as a
+								   unsigned);		// mapped weight file, instead of the owned weights.
+			void set_vertex(unsigned, const Point3d&,
+							const double*);			// Assigns a vertex position and weights, the weights
+													// are skipped when NULL or in an external buffer.
+			void set_polygons(unsigned, const int*,	// Builds the triangle and polygon arrays from the number of
+							  const int*, unsigned);	// triangles in each polygon and the triangle vertex indexes,
+													// spread over the given number of threads.  The data of
+													// every face is built the first time it is sampled.
+			void build_faces(unsigned) const;		// Builds the data of every face not built yet.
+			unsigned get_built_face_count() const;	// Returns the number of faces whose data has been built.
+			bool append_surface(const WeightedSurface&);	// Appends the vertices, weights and polygons of another
+														// surface with the same number of channels.  The search
+														// structures have to be built again afterwards.
+			void build_tree(unsigned);				// Builds the closest point search tree over the triangles,
+													// spread over the given number of threads, and the
+													// triangles around every vertex.
+
+			int get_matching_vertex(unsigned, const Point3d&) const;		// Tests a polygon's vertices to see if any have an equal position to the sample point.
+			unsigned get_intersected_triangle(unsigned, const Point3d&) const;	// Find a polygon's triangle that contains the sample point.
+			template<class Interpolation>
+			void sample_polygon(unsigned, const Point3d&, double*) const;	// Samples the weights of a polygon at a point on its surface.
+			void copy_weights(unsigned, double*) const;	// Returns a copy of a vertex's weights.
+			double quantize_weights();				// Replaces the weights with 16-bit values scaled to the range of
+													// every channel and returns the largest quantization error.
+			bool is_quantized() const;				// Returns true if the weights are quantized.
+			void build_vertex_hash();				// Hashes the vertex positions for find_vertex.
+			int find_vertex(const Point3d&) const;	// Returns the index of a vertex equal to the sample point or -1.
+
+			// surface weight sample methods
+			bool sample_vertex(const Point3d&, double*) const;	// Copies the weights of a vertex which coincides
+																// with the sample position, if any.
+			template<class Interpolation>
+			void sample_surface(const Point3d&, double,	// Samples the weights at the closest point on the surface
+								double*, double&) const;	// to an arbitrary position within a maximum distance.
+			template<class Interpolation>
+			bool sample_surface_from(const Point3d&,	// Samples the weights at the closest point on the surface,
+									 double,			// walking from the closest triangle of a nearby position.
+									 SearchSeed&,		// Returns true if the walk was used rather than a global search.
+									 double*, double&) const;
+			unsigned get_triangle_face(unsigned) const;		// Returns the index of the polygon a triangle belongs to.
+
+			// surface sample stencil methods, for interpolation policies which blend linearly
+			template<class Interpolation>
+			void get_polygon_stencil(unsigned,		// Returns the vertices and coefficients a sample of
+									 const Point3d&,	// a polygon at a point on its surface blends.
+									 SampleStencil&) const;
+			bool get_vertex_stencil(const Point3d&,	// Returns the vertex which coincides with the sample
+									SampleStencil&) const;	// position, if any, as a stencil.
+			template<class Interpolation>
+			void get_surface_stencil(const Point3d&, double,	// Returns the stencil of the closest point on the
+									 SampleStencil&,			// surface to an arbitrary position within a
+									 double&) const;			// maximum distance.
+			template<class Interpolation>
+			bool get_surface_stencil_from(const Point3d&,	// Returns the stencil of the closest point on the
+										  double,			// surface, walking from the closest triangle of a
+										  SearchSeed&,		// nearby position.  Returns true if the walk was
+										  SampleStencil&,	// used rather than a global search.
+										  double&) const;
+
+			void get_buffers(SurfaceBuffers&) const;	// Returns the arrays of the built surface.
+			void set_buffers(const SurfaceBuffers&);	// Samples from the external arrays of a built surface
+														// instead of owned arrays and rebuilds the vertex hash.
+
+			unsigned get_vertex_count() const;		// Returns the number of vertices in the surface.
+			unsigned get_polygon_count() const;		// Returns the number of polygons in the surface.
+			unsigned get_channel_count() const;		// Returns the number of weight channels per vertex.
+			unsigned get_triangle_count() const;	// Returns the number of triangles in the surface.
+			size_t get_memory_size() const;			// Returns the number of bytes used by the surface arrays.
+			static size_t get_legacy_triangle_size();	// Returns the bytes per triangle of the previous pointer-based layout.
+
+		private:
+			void build_vertex_triangles();			// Lists the triangles around every vertex.
+			void build_face(unsigned) const;		// Builds the planes of a polygon's triangles and its vertex list.
+			void build_face_once(unsigned) const;	// Builds a face's data unless it is built already.
+			const double* get_vertex_weights(unsigned,	// Returns the channel_count weights of a vertex, decoded
+											 double*) const;	// into the buffer when they are quantized.
+			bool find_closest_from(const Point3d&,	// Finds the closest triangle and point on the surface
+								   double,			// within a maximum distance, walking from the seed when
+								   SearchSeed&,		// it is near enough, and updates the seed.  Returns false
+								   unsigned&,		// if no point is in range.
+								   Point3d&,
+								   bool&) const;
+			double get_seed_range_sq(unsigned) const;	// Returns the squared distance from a seed position
+														// within which its triangle starts a walk.
+			bool walk_to_closest(const Point3d&,	// Walks from a triangle to closer triangles sharing a vertex
+								 unsigned&,			// with it until none is closer, returns false if the walk
+								 Point3d&) const;	// takes too many steps.
+
+			unsigned vertex_count;					// The number of vertices in the surface.
+			unsigned polygon_count;					// The number of polygons in the surface.
+			unsigned triangle_count;				// The number of triangles in the surface.
+			unsigned poly_vert_count;				// The number of polygon vertex list entries.
+			unsigned channel_count;					// The number of weight channels stored per vertex.
+			const Point3d* positions;				// The world space position of every vertex.
+			const double* weights;					// channel_count weights for every vertex, NULL when quantized.
+			const unsigned short* quantized_weights;	// channel_count quantized weights for every vertex or NULL.
+			double weight_scale[WEIGHT_COUNT];		// The decoding scale of every quantized channel.
+			double weight_offset[WEIGHT_COUNT];		// The decoding offset of every quantized channel.
+			const WeightedTriangle* tris;			// The triangles of every polygon.
+			const WeightedPolygon* polys;			// The triangle and vertex ranges of every polygon, plus an end marker.
+			const unsigned* poly_verts;				// The unique vertex indexes of every polygon.
+			std::vector<Point3d> owned_positions;	// The positions when they are not in an external buffer.
+			std::vector<double> owned_weights;		// The weights when they are not in an external buffer.
+			std::vector<unsigned short> owned_quantized_weights;	// The quantized weights when they are not in an external buffer.
+			mutable std::vector<WeightedTriangle> owned_tris;	// The triangles when they are not in an external buffer,
+														// whose planes are built on demand by the sample methods.
+			std::vector<WeightedPolygon> owned_polys;	// The polygons when they are not in an external buffer.
+			mutable std::vector<unsigned> owned_poly_verts;	// The polygon vertices when they are not in an external buffer.
+			mutable std::unique_ptr<std::atomic<unsigned char>[]> face_states;	// The FaceState of every polygon, or NULL
+																				// when every polygon is built.
+			mutable std::atomic<unsigned> built_face_count;	// The number of polygons built since set_polygons.
+			std::vector<unsigned> vertex_tri_offsets;	// The start of every vertex's triangles, plus an end marker.
+			std::vector<unsigned> vertex_tris;		// The triangles around every vertex.
+			VertexHash vertex_hash;					// The spatial hash of the vertex positions.
+			TriangleTree tree;						// The closest point search tree over the triangles.
+	};
+}
+
+#endif // end if undefined __WEIGHTED_SURFACE__